@@ -0,0 +1,92 @@
+#include "AllocCounter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+#ifdef COUNT_ALLOCATIONS
+
+static atomic<unsigned long long> allocations(0);
+
+bool AllocCounter::isAvailable()
+{
+	return true;
+}
+
+unsigned long long AllocCounter::getCount()
+{
+	return allocations.load(memory_order_relaxed);
+}
+
+// The library's array, nothrow and sized forms all call these
+void *operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	void *p = malloc(size > 0 ? size : 1);
+	if(!p) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void *operator new(size_t size, align_val_t align)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	size_t a = (size_t)align;
+#ifdef _WIN32
+	// MSVC has no aligned_alloc; its aligned blocks need _aligned_free
+	void *p = _aligned_malloc(max(size, (size_t)1), a);
+#else
+	// aligned_alloc needs a multiple of the alignment
+	void *p = aligned_alloc(a, (max(size, (size_t)1) + a - 1) / a * a);
+#endif
+	if(!p) {
+		throw bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void operator delete(void *p, size_t, align_val_t align) noexcept
+{
+	operator delete(p, align);
+}
+
+#else
+
+bool AllocCounter::isAvailable()
+{
+	return false;
+}
+
+unsigned long long AllocCounter::getCount()
+{
+	return 0;
+}
+
+#endif
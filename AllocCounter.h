@@ -0,0 +1,22 @@
+#pragma once
+#ifndef _ALLOCCOUNTER_H_
+#define _ALLOCCOUNTER_H_
+
+/**
+ * Counts heap allocations made through the global operator new.
+ * Building with COUNT_ALLOCATIONS replaces operator new and delete with
+ * versions that bump a process-wide counter, so a caller can check that a
+ * stretch of code does not allocate. Without it the count stays at zero.
+ * Memory taken directly with malloc is not counted. bench/alloc_check is
+ * built this way to check the simulation's steady state.
+ */
+namespace AllocCounter {
+
+	// Whether this build replaces operator new
+	bool isAvailable();
+	// Allocations made so far by every thread
+	unsigned long long getCount();
+
+}
+
+#endif
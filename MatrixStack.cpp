@@ -1,19 +1,17 @@
 #include "MatrixStack.h"
 
 #include <stdio.h>
-#include <cassert>
-#include <vector>
+#include <stdlib.h>
 
-#define GLM_FORCE_RADIANS
-#include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 using namespace std;
 
-MatrixStack::MatrixStack()
+MatrixStack::MatrixStack() :
+	depth(0)
 {
-	mstack = make_shared< stack<glm::mat4> >();
-	mstack->push(glm::mat4(1.0));
+	mats[0] = glm::mat4(1.0);
+	cached[0] = 0;
 }
 
 MatrixStack::~MatrixStack()
@@ -22,29 +20,44 @@ MatrixStack::~MatrixStack()
 
 void MatrixStack::pushMatrix()
 {
-	const glm::mat4 &top = mstack->top();
-	mstack->push(top);
-	assert(mstack->size() < 100);
+	// Checked in every build: an overflow would write past the arrays
+	if(depth + 1 >= CAPACITY) {
+		fprintf(stderr, "MatrixStack: more than %d matrices pushed\n", CAPACITY);
+		abort();
+	}
+	// The copy has the same inverse and normal matrices
+	mats[depth + 1] = mats[depth];
+	cached[depth + 1] = cached[depth];
+	if(cached[depth] & INVERSE) {
+		inverses[depth + 1] = inverses[depth];
+	}
+	if(cached[depth] & NORMAL) {
+		normals[depth + 1] = normals[depth];
+	}
+	++depth;
 }
 
 void MatrixStack::popMatrix()
 {
-	assert(!mstack->empty());
-	mstack->pop();
 	// There should always be one matrix left.
-	assert(!mstack->empty());
+	if(depth == 0) {
+		fprintf(stderr, "MatrixStack: popped the last matrix\n");
+		abort();
+	}
+	--depth;
 }
 
 void MatrixStack::loadIdentity()
 {
-	glm::mat4 &top = mstack->top();
-	top = glm::mat4(1.0);
+	mats[depth] = glm::mat4(1.0);
+	cached[depth] = 0;
 }
 
 void MatrixStack::translate(const glm::vec3 &t)
 {
-	glm::mat4 &top = mstack->top();
+	glm::mat4 &top = mats[depth];
 	top *= glm::translate(glm::mat4(1.0f), t);
+	cached[depth] = 0;
 }
 
 void MatrixStack::translate(float x, float y, float z)
@@ -54,8 +67,9 @@ void MatrixStack::translate(float x, float y, float z)
 
 void MatrixStack::scale(const glm::vec3 &s)
 {
-	glm::mat4 &top = mstack->top();
+	glm::mat4 &top = mats[depth];
 	top *= glm::scale(glm::mat4(1.0f), s);
+	cached[depth] = 0;
 }
 
 void MatrixStack::scale(float x, float y, float z)
@@ -70,8 +84,9 @@ void MatrixStack::scale(float s)
 
 void MatrixStack::rotate(float angle, const glm::vec3 &axis)
 {
-	glm::mat4 &top = mstack->top();
+	glm::mat4 &top = mats[depth];
 	top *= glm::rotate(glm::mat4(1.0f), angle, axis);
+	cached[depth] = 0;
 }
 
 void MatrixStack::rotate(float angle, float x, float y, float z)
@@ -81,13 +96,27 @@ void MatrixStack::rotate(float angle, float x, float y, float z)
 
 void MatrixStack::multMatrix(const glm::mat4 &matrix)
 {
-	glm::mat4 &top = mstack->top();
+	glm::mat4 &top = mats[depth];
 	top *= matrix;
+	cached[depth] = 0;
 }
 
-const glm::mat4 &MatrixStack::topMatrix() const
+const glm::mat4 &MatrixStack::inverseMatrix() const
 {
-	return mstack->top();
+	if(!(cached[depth] & INVERSE)) {
+		inverses[depth] = glm::inverse(mats[depth]);
+		cached[depth] |= INVERSE;
+	}
+	return inverses[depth];
+}
+
+const glm::mat4 &MatrixStack::normalMatrix() const
+{
+	if(!(cached[depth] & NORMAL)) {
+		normals[depth] = glm::transpose(inverseMatrix());
+		cached[depth] |= NORMAL;
+	}
+	return normals[depth];
 }
 
 void MatrixStack::print(const glm::mat4 &mat, const char *name)
@@ -110,5 +139,5 @@ void MatrixStack::print(const glm::mat4 &mat, const char *name)
 
 void MatrixStack::print(const char *name) const
 {
-	print(mstack->top(), name);
+	print(mats[depth], name);
 }
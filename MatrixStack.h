@@ -2,19 +2,36 @@
 #ifndef _MatrixStack_H_
 #define _MatrixStack_H_
 
-#include <stack>
-#include <memory>
-#include <glm/fwd.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
 
+// Most matrices a stack can hold. The default keeps the depth of the old
+// heap-based stack; build with -DMATRIXSTACK_CAPACITY=N to change it.
+#ifndef MATRIXSTACK_CAPACITY
+#define MATRIXSTACK_CAPACITY 100
+#endif
+
+/**
+ * A stack of 4x4 matrices stored inline, so pushing and popping never
+ * touch the heap. The inverse and normal matrices of each level are
+ * computed when first asked for and kept until that level changes, so a
+ * parent's survive the push and pop of its children.
+ */
 class MatrixStack
 {
 public:
+	// Most matrices the stack can hold
+	static const int CAPACITY = MATRIXSTACK_CAPACITY;
+	static_assert(CAPACITY >= 1, "MATRIXSTACK_CAPACITY must be at least 1");
+	
 	MatrixStack();
 	virtual ~MatrixStack();
 	
-	// glPushMatrix(): Copies the current matrix and adds it to the top of the stack
+	// glPushMatrix(): Copies the current matrix and adds it to the top of the stack.
+	// Aborts if the stack already holds CAPACITY matrices.
 	void pushMatrix();
-	// glPopMatrix(): Removes the top of the stack and sets the current matrix to be the matrix that is now on top
+	// glPopMatrix(): Removes the top of the stack and sets the current matrix to be the matrix that is now on top.
+	// Aborts if only one matrix is left.
 	void popMatrix();
 	
 	// glLoadIdentity(): Sets the top matrix to be the identity
@@ -35,7 +52,13 @@ public:
 	void rotate(float angle, float x, float y, float z);
 	
 	// glGet(GL_MODELVIEW_MATRIX): Gets the top matrix
-	const glm::mat4 &topMatrix() const;
+	const glm::mat4 &topMatrix() const { return mats[depth]; }
+	// Inverse of the top matrix
+	const glm::mat4 &inverseMatrix() const;
+	// Inverse transpose of the top matrix, which transforms normals
+	const glm::mat4 &normalMatrix() const;
+	// Number of matrices on the stack
+	int size() const { return depth + 1; }
 	
 	// Prints out the specified matrix
 	static void print(const glm::mat4 &mat, const char *name = 0);
@@ -43,7 +66,14 @@ public:
 	void print(const char *name = 0) const;
 	
 private:
-	std::shared_ptr< std::stack<glm::mat4> > mstack;
+	// Bits of cached[], set while the matrix of that level is up to date
+	enum { INVERSE = 1, NORMAL = 2 };
+	
+	glm::mat4 mats[CAPACITY];
+	int depth; // index of the top matrix
+	mutable glm::mat4 inverses[CAPACITY];
+	mutable glm::mat4 normals[CAPACITY];
+	mutable unsigned char cached[CAPACITY];
 	
 };
 
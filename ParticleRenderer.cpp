@@ -0,0 +1,115 @@
+#include "ParticleRenderer.h"
+
+#include <cassert>
+
+#include "GLSL.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "Program.h"
+
+using namespace std;
+
+ParticleRenderer::ParticleRenderer() :
+	aPos(-1),
+	aAlp(-1),
+	aCol(-1),
+	aSca(-1),
+	posBufID(0),
+	colBufID(0),
+	alpBufID(0),
+	scaBufID(0)
+{
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+}
+
+void ParticleRenderer::init(const ParticleSystem &particles, shared_ptr<Program> prog)
+{
+	this->prog = prog;
+	aPos = prog->addAttribute("aPos");
+	aAlp = prog->addAttribute("aAlp");
+	aCol = prog->addAttribute("aCol");
+	aSca = prog->addAttribute("aSca");
+	
+	// Generate buffer IDs
+	GLuint bufs[4];
+	glGenBuffers(4, bufs);
+	posBufID = bufs[0];
+	colBufID = bufs[1];
+	alpBufID = bufs[2];
+	scaBufID = bufs[3];
+	
+	const vector<float> &colBuf = particles.getColBuf();
+	const vector<float> &scaBuf = particles.getScaBuf();
+	
+	// Send color buffer to GPU
+	glBindBuffer(GL_ARRAY_BUFFER, colBufID);
+	glBufferData(GL_ARRAY_BUFFER, colBuf.size()*sizeof(float), colBuf.data(), GL_STATIC_DRAW);
+	
+	// Send scale buffer to GPU
+	glBindBuffer(GL_ARRAY_BUFFER, scaBufID);
+	glBufferData(GL_ARRAY_BUFFER, scaBuf.size()*sizeof(float), scaBuf.data(), GL_STATIC_DRAW);
+	
+	assert(glGetError() == GL_NO_ERROR);
+}
+
+void ParticleRenderer::draw(const ParticleState &state, float alpha)
+{
+	GLsizei n = (GLsizei)state.alpBuf.size();
+	{
+		PROFILE_ZONE("upload");
+		const vector<float> *pos = &state.posBuf;
+		if(alpha < 1.0f) {
+			state.interpolate(alpha, interpBuf);
+			pos = &interpBuf;
+		}
+		const vector<float> &posBuf = *pos;
+		const vector<float> &alpBuf = state.alpBuf;
+		
+		// Send position array
+		glBindBuffer(GL_ARRAY_BUFFER, posBufID);
+		glBufferData(GL_ARRAY_BUFFER, posBuf.size()*sizeof(float), posBuf.data(), GL_DYNAMIC_DRAW);
+		
+		// Send alpha array
+		glBindBuffer(GL_ARRAY_BUFFER, alpBufID);
+		glBufferData(GL_ARRAY_BUFFER, alpBuf.size()*sizeof(float), alpBuf.data(), GL_DYNAMIC_DRAW);
+	}
+	
+	PROFILE_ZONE("draw");
+	GLint pos = prog->getAttribute(aPos);
+	GLint alp = prog->getAttribute(aAlp);
+	GLint col = prog->getAttribute(aCol);
+	GLint sca = prog->getAttribute(aSca);
+	
+	// Enable and bind position array
+	glEnableVertexAttribArray(pos);
+	glBindBuffer(GL_ARRAY_BUFFER, posBufID);
+	glVertexAttribPointer(pos, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	// Enable and bind alpha array
+	glEnableVertexAttribArray(alp);
+	glBindBuffer(GL_ARRAY_BUFFER, alpBufID);
+	glVertexAttribPointer(alp, 1, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	// Enable and bind color array
+	glEnableVertexAttribArray(col);
+	glBindBuffer(GL_ARRAY_BUFFER, colBufID);
+	glVertexAttribPointer(col, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	// Enable and bind scale array
+	glEnableVertexAttribArray(sca);
+	glBindBuffer(GL_ARRAY_BUFFER, scaBufID);
+	glVertexAttribPointer(sca, 1, GL_FLOAT, GL_FALSE, 0, 0);
+	
+	// Draw
+	glDrawArrays(GL_POINTS, 0, n);
+	
+	// Disable and unbind
+	glDisableVertexAttribArray(sca);
+	glDisableVertexAttribArray(col);
+	glDisableVertexAttribArray(alp);
+	glDisableVertexAttribArray(pos);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
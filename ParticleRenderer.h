@@ -0,0 +1,48 @@
+#pragma once
+#ifndef _PARTICLERENDERER_H_
+#define _PARTICLERENDERER_H_
+
+#include <memory>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+class ParticleSystem;
+struct ParticleState;
+class Program;
+
+/**
+ * Draws a ParticleSystem as point sprites.
+ * Owns the GPU copies of the particle columns.
+ */
+class ParticleRenderer
+{
+public:
+	ParticleRenderer();
+	virtual ~ParticleRenderer();
+	
+	// Creates the GPU buffers and sends the fixed columns (color, scale).
+	// Adds the attributes it draws with to prog.
+	// Must be called after the GL context has been created.
+	void init(const ParticleSystem &particles, std::shared_ptr<Program> prog);
+	// Sends the per-frame columns (position, alpha) and draws with the
+	// program given to init(), which must be bound. Positions are
+	// interpolated between the last two steps by alpha (see SimClock).
+	void draw(const ParticleState &state, float alpha = 1.0f);
+	
+private:
+	std::shared_ptr<Program> prog;
+	// Attribute handles of prog
+	int aPos;
+	int aAlp;
+	int aCol;
+	int aSca;
+	GLuint posBufID;
+	GLuint colBufID;
+	GLuint alpBufID;
+	GLuint scaBufID;
+	std::vector<float> interpBuf;
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "ParticleSystem.h"
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "Random.h"
+
+using namespace std;
+using namespace Eigen;
+
+// Random stream of generation g of particle i. Streams below 2^32 are for
+// values of the whole system; stream 0 holds the fixed properties.
+static uint64_t particleStream(int i, uint32_t g)
+{
+	return ((uint64_t)(g + 1) << 32) | (uint32_t)i;
+}
+
+ParticleSystem::ParticleSystem() :
+	n(0),
+	seed(0x2545F4914F6CDD1Dull)
+{
+}
+
+ParticleSystem::~ParticleSystem()
+{
+}
+
+void ParticleSystem::init(int n)
+{
+	this->n = n;
+	colBuf.resize(3*n);
+	shapeIndex.assign(n, 0);
+	vertIndex.assign(n, 0);
+	m.assign(n, 1.0f);
+	d.assign(n, 0.0f);
+	lifespan.assign(n, 0.0f);
+	tEnd.assign(n, 0.0f);
+	tExplode.assign(n, 0.0f);
+	generation.assign(n, 0);
+	posBuf.assign(3*n, 0.0f);
+	prevBuf.assign(3*n, 0.0f);
+	velBuf.assign(3*n, 0.0f);
+	alpBuf.assign(n, 1.0f);
+	// Everyone is born rising
+	rising.resize(n);
+	for(int i = 0; i < n; ++i) {
+		rising[i] = i;
+	}
+	exploding.clear();
+	crossing.clear();
+	targeted.clear();
+	// Each list can hold every particle, so updatePhases() never allocates
+	exploding.reserve(n);
+	crossing.reserve(n);
+	targeted.reserve(n);
+	scratch.reserve(n);
+	
+	// Random fixed properties
+	Random rng(seed, 0);
+	rng.fillFloats(colBuf.data(), 3*n, 0.5f, 1.0f);
+	scaBuf.assign(n, 0.025f);
+}
+
+void ParticleSystem::rebirth(int i, float t, const bool *keyToggles, const Vector3f &p0, const Vector3f &v0)
+{
+	m[i] = 1.0f;
+	alpBuf[i] = 1.0f;
+	
+	Vector3f start = 0.001 * p0;
+	
+	Random rng(seed, particleStream(i, generation[i]++));
+	d[i] = rng.nextFloat(0.0f, 3.0f);
+	Map<Vector3f> x(&posBuf[3*i]);
+	Map<Vector3f> v(&velBuf[3*i]);
+	Map<Vector3f> prev(&prevBuf[3*i]);
+	x = start;
+	// Do not interpolate from where the particle died
+	prev = start;
+	v << 0.0f, 1.0f, 0.0f;
+	lifespan[i] = 2.4f;
+	tExplode[i] = lifespan[i];
+	
+	tEnd[i] = t + lifespan[i];
+}
+
+void ParticleSystem::explode(int i, float tExplode, float h, const Vector3f &g, const Vector3f &pos)
+{
+	float scale = 10000 * (lifespan[i] - tExplode);
+	
+	Map<Vector3f> x(&posBuf[3*i]);
+	Map<Vector3f> v(&velBuf[3*i]);
+	Vector3f f = scale * (pos - v);
+	v += (h / m[i]) * f;
+	
+	x += h * v;
+	
+	v = pos;
+}
+
+// Particles explode once less than this many seconds of life are left
+static const double EXPLODE_TIME = 1.14;
+
+void ParticleSystem::updatePhases(float t, const vector<int> &dead)
+{
+	// Rising particles that have reached the explosion, keeping both in order
+	crossing.clear();
+	scratch.clear();
+	auto d = dead.begin();
+	for(int i : rising) {
+		while(d != dead.end() && *d < i) {
+			++d;
+		}
+		if(d != dead.end() && *d == i) {
+			continue;
+		}
+		float tStep = tEnd[i] - t;
+		if(tStep < EXPLODE_TIME) {
+			crossing.push_back(i);
+		} else {
+			scratch.push_back(i);
+		}
+	}
+	// The dead are reborn rising
+	rising.clear();
+	merge(scratch.begin(), scratch.end(), dead.begin(), dead.end(), back_inserter(rising));
+	scratch.clear();
+	set_difference(exploding.begin(), exploding.end(), dead.begin(), dead.end(), back_inserter(scratch));
+	exploding.clear();
+	merge(scratch.begin(), scratch.end(), crossing.begin(), crossing.end(), back_inserter(exploding));
+	targeted.clear();
+	merge(exploding.begin(), exploding.end(), dead.begin(), dead.end(), back_inserter(targeted));
+}
+
+void ParticleSystem::stepRange(int begin, int end, float t, float h, const Vector3f &g, const float *targets)
+{
+	for(int j = 3*begin; j < 3*end; ++j) {
+		prevBuf[j] = posBuf[j];
+	}
+	// Update alpha based on current time
+	for(int i = begin; i < end; ++i) {
+		alpBuf[i] = (tEnd[i] - t) / lifespan[i];
+	}
+	// Rising: Euler step
+	auto r0 = lower_bound(rising.begin(), rising.end(), begin);
+	auto r1 = lower_bound(r0, rising.end(), end);
+	for(auto it = r0; it != r1; ++it) {
+		int i = *it;
+		posBuf[3*i+0] += h * velBuf[3*i+0];
+		posBuf[3*i+1] += h * velBuf[3*i+1];
+		posBuf[3*i+2] += h * velBuf[3*i+2];
+	}
+	// The velocity of an exploding particle holds its target from the last
+	// step, so the ones entering the explosion start from their target
+	auto c0 = lower_bound(crossing.begin(), crossing.end(), begin);
+	auto c1 = lower_bound(c0, crossing.end(), end);
+	for(auto it = c0; it != c1; ++it) {
+		int i = *it;
+		velBuf[3*i+0] = targets[3*i+0];
+		velBuf[3*i+1] = targets[3*i+1];
+		velBuf[3*i+2] = targets[3*i+2];
+	}
+	// Exploding: pulled towards the target
+	auto e0 = lower_bound(exploding.begin(), exploding.end(), begin);
+	auto e1 = lower_bound(e0, exploding.end(), end);
+	for(auto it = e0; it != e1; ++it) {
+		int i = *it;
+		Map<const Vector3f> pos(&targets[3*i]);
+		explode(i, tExplode[i], h, g, pos);
+		tExplode[i] -= h;
+	}
+}
+
+void ParticleSystem::hold()
+{
+	prevBuf.assign(posBuf.begin(), posBuf.end());
+}
+
+void ParticleSystem::snapshot(ParticleState &state) const
+{
+	// assign() reuses the state's storage once it has grown to size
+	state.posBuf.assign(posBuf.begin(), posBuf.end());
+	state.prevBuf.assign(prevBuf.begin(), prevBuf.end());
+	state.alpBuf.assign(alpBuf.begin(), alpBuf.end());
+}
+
+void ParticleState::interpolate(float alpha, vector<float> &out) const
+{
+	out.resize(posBuf.size());
+	for(size_t j = 0; j < posBuf.size(); ++j) {
+		out[j] = prevBuf[j] + alpha*(posBuf[j] - prevBuf[j]);
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#ifndef _PARTICLESYSTEM_H_
+#define _PARTICLESYSTEM_H_
+
+#define _USE_MATH_DEFINES
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+/**
+ * Copy of the per-frame particle columns, handed from the simulation to the
+ * renderer.
+ */
+struct ParticleState
+{
+	std::vector<float> posBuf;
+	std::vector<float> prevBuf; // position before the last step
+	std::vector<float> alpBuf;
+	double time;                // wall time the state is due at
+	
+	// Positions between the last two steps: prev + alpha * (pos - prev)
+	void interpolate(float alpha, std::vector<float> &out) const;
+};
+
+/**
+ * All particles, stored as structure-of-arrays.
+ * Particle i owns element i of every scalar column and elements 3*i..3*i+2
+ * of every vector column. posBuf, colBuf, alpBuf, and scaBuf are laid out
+ * exactly as the vertex shader consumes them. No OpenGL calls are made here;
+ * see ParticleRenderer.
+ */
+class ParticleSystem
+{
+public:
+	ParticleSystem();
+	virtual ~ParticleSystem();
+	
+	// Random values depend only on the seed, so the same seed gives the same
+	// show for any number of threads. Takes effect at the next init().
+	void setSeed(uint64_t seed) { this->seed = seed; }
+	void init(int n);
+	int size() const { return n; }
+	
+	void setShapeIndex(int i, int s) { shapeIndex[i] = s; }
+	int getShapeIndex(int i) const { return shapeIndex[i]; }
+	void setVertIndex(int i, int v) { vertIndex[i] = v; }
+	int getVertIndex(int i) const { return vertIndex[i]; }
+	
+	void rebirth(int i, float t, const bool *keyToggles, const Eigen::Vector3f &p0, const Eigen::Vector3f &v0);
+	// Time particle i dies. The caller rebirths it on the first step with t > getEndTime(i).
+	float getEndTime(int i) const { return tEnd[i]; }
+	void explode(int i, float tExplode, float h, const Eigen::Vector3f &g, const Eigen::Vector3f &pos);
+	
+	// Particles in each phase of their life, in ascending order.
+	// Rising particles fly up; exploding ones are pulled towards their target.
+	const std::vector<int> &getRising() const { return rising; }
+	const std::vector<int> &getExploding() const { return exploding; }
+	bool isExploding(int i) const { return std::binary_search(exploding.begin(), exploding.end(), i); }
+	// Particles that read their target on this step: the exploding and the dead
+	const std::vector<int> &getTargeted() const { return targeted; }
+	// Moves particles between phases at time t, before a step. dead are the
+	// particles that will be reborn on this step, in ascending order.
+	void updatePhases(float t, const std::vector<int> &dead);
+	// Steps the particles [begin, end) after updatePhases(). Each phase is run
+	// by its own loop. targets holds 3 floats per particle.
+	void stepRange(int begin, int end, float t, float h, const Eigen::Vector3f &g, const float *targets);
+	// Makes the last step a standstill, for a paused show: prev = pos
+	void hold();
+	
+	const std::vector<float> &getPosBuf() const { return posBuf; }
+	// Position before the last step
+	const std::vector<float> &getPrevBuf() const { return prevBuf; }
+	// Copies the per-frame columns
+	void snapshot(ParticleState &state) const;
+	const std::vector<float> &getColBuf() const { return colBuf; }
+	const std::vector<float> &getAlpBuf() const { return alpBuf; }
+	const std::vector<float> &getScaBuf() const { return scaBuf; }
+	
+private:
+	int n;
+	uint64_t seed;
+	
+	// Properties that are fixed
+	std::vector<float> colBuf; // color
+	std::vector<float> scaBuf; // size
+	std::vector<int> shapeIndex;
+	std::vector<int> vertIndex; // vertex of the shape this particle follows
+	
+	// Properties that changes every rebirth
+	std::vector<float> m;        // mass
+	std::vector<float> d;        // viscous damping
+	std::vector<float> lifespan; // how long this particle lives
+	std::vector<float> tEnd;     // time this particle dies
+	std::vector<float> tExplode; // for scaling purposes
+	std::vector<uint32_t> generation; // number of rebirths, selects the random stream
+	
+	// Properties that changes every frame
+	std::vector<float> posBuf; // position
+	std::vector<float> prevBuf; // position before the last step
+	std::vector<float> velBuf; // velocity
+	std::vector<float> alpBuf; // alpha
+	
+	// Phases, see updatePhases()
+	std::vector<int> rising;
+	std::vector<int> exploding;
+	std::vector<int> crossing; // rising particles that start exploding on this step
+	std::vector<int> targeted;
+	std::vector<int> scratch;
+};
+
+#endif
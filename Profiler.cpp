@@ -0,0 +1,182 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace Profiler {
+
+atomic<bool> enabled(false);
+
+// The last WINDOW samples of one zone on one thread. Only that thread
+// writes them, so recording takes no lock; a reader may see a sample as it
+// is overwritten, which only blurs the statistics.
+struct ThreadSamples
+{
+	atomic<float> samples[WINDOW];
+	atomic<unsigned long> count; // all samples ever recorded
+};
+
+// Threads that can be profiled: one per hardware thread for the pool, plus
+// the main and simulation threads and a margin. Any beyond are reported once.
+static int getMaxThreads()
+{
+	static const int n = (int)max(thread::hardware_concurrency(), 1u) + 16;
+	return n;
+}
+
+// MAX_ZONES samples of each thread, allocated once and zeroed by calloc, so
+// recording never allocates and pages are only touched for the zones a
+// thread records. Samples outlive their threads, so exited workers still
+// report.
+static ThreadSamples *getThreadSamples()
+{
+	static ThreadSamples *samples = (ThreadSamples *)calloc((size_t)getMaxThreads() * MAX_ZONES, sizeof(ThreadSamples));
+	return samples;
+}
+static atomic<int> threadCount(0);
+
+// Zones are kept in place, so one first reached late does not allocate.
+// Those beyond MAX_ZONES are traced but have no samples.
+static mutex zonesMutex;
+static Zone zones[MAX_ZONES];
+static int zoneCount = 0;
+static vector< unique_ptr<Zone> > &getOverflowZones()
+{
+	static vector< unique_ptr<Zone> > overflow;
+	return overflow;
+}
+
+void setEnabled(bool e)
+{
+	enabled.store(e, memory_order_relaxed);
+}
+
+Zone *getZone(const char *name)
+{
+	lock_guard<mutex> lock(zonesMutex);
+	for(int i = 0; i < zoneCount; ++i) {
+		if(strcmp(zones[i].name, name) == 0) {
+			return &zones[i];
+		}
+	}
+	if(zoneCount < MAX_ZONES) {
+		zones[zoneCount].name = name;
+		zones[zoneCount].id = zoneCount;
+		return &zones[zoneCount++];
+	}
+	auto &overflow = getOverflowZones();
+	for(auto &z : overflow) {
+		if(strcmp(z->name, name) == 0) {
+			return z.get();
+		}
+	}
+	unique_ptr<Zone> z(new Zone());
+	z->name = name;
+	z->id = MAX_ZONES;
+	overflow.push_back(move(z));
+	return overflow.back().get();
+}
+
+void record(Zone *zone, double ms)
+{
+	thread_local int thread = threadCount.fetch_add(1, memory_order_relaxed);
+	ThreadSamples *samples = getThreadSamples();
+	if(thread >= getMaxThreads() || !samples) {
+		static atomic<bool> reported(false);
+		if(!reported.exchange(true)) {
+			cerr << "Profiler: more than " << getMaxThreads() << " threads, the others are not profiled" << endl;
+		}
+		return;
+	}
+	if(zone->id >= MAX_ZONES) {
+		return;
+	}
+	ThreadSamples &s = samples[(size_t)thread * MAX_ZONES + zone->id];
+	unsigned long n = s.count.load(memory_order_relaxed);
+	s.samples[n % WINDOW].store((float)ms, memory_order_relaxed);
+	s.count.store(n + 1, memory_order_release);
+}
+
+Stats getStats(Zone *zone)
+{
+	// Reused, so asking for statistics does not allocate once it has grown
+	thread_local vector<float> s;
+	s.clear();
+	Stats st;
+	st.count = 0;
+	st.min = st.mean = st.p99 = st.max = 0.0;
+	if(zone->id >= MAX_ZONES) {
+		return st;
+	}
+	ThreadSamples *samples = getThreadSamples();
+	int threads = samples ? min(threadCount.load(memory_order_relaxed), getMaxThreads()) : 0;
+	for(int t = 0; t < threads; ++t) {
+		const ThreadSamples &ts = samples[(size_t)t * MAX_ZONES + zone->id];
+		unsigned long count = ts.count.load(memory_order_acquire);
+		st.count += count;
+		for(unsigned long i = 0; i < min(count, (unsigned long)WINDOW); ++i) {
+			s.push_back(ts.samples[i].load(memory_order_relaxed));
+		}
+	}
+	if(s.empty()) {
+		return st;
+	}
+	double sum = 0.0;
+	for(float x : s) {
+		sum += x;
+	}
+	st.mean = sum / s.size();
+	size_t k = min(s.size() - 1, (size_t)(0.99 * s.size()));
+	nth_element(s.begin(), s.begin() + k, s.end());
+	st.p99 = s[k];
+	st.min = *min_element(s.begin(), s.end());
+	st.max = *max_element(s.begin(), s.end());
+	return st;
+}
+
+void report(ostream &out)
+{
+	int count;
+	{
+		lock_guard<mutex> lock(zonesMutex);
+		count = zoneCount;
+	}
+	out << "Profile (ms over the last " << WINDOW << " samples of each zone and thread)" << endl;
+	out << left << setw(16) << "zone" << right << setw(10) << "count"
+		<< setw(10) << "min" << setw(10) << "mean" << setw(10) << "p99" << setw(10) << "max" << endl;
+	out << fixed << setprecision(3);
+	// Zones are filled in before zoneCount grows, under the lock
+	for(int i = 0; i < count; ++i) {
+		Zone *z = &zones[i];
+		Stats st = getStats(z);
+		if(st.count == 0) {
+			continue;
+		}
+		out << left << setw(16) << z->name << right << setw(10) << st.count
+			<< setw(10) << st.min << setw(10) << st.mean << setw(10) << st.p99 << setw(10) << st.max << endl;
+	}
+	out.unsetf(ios::floatfield);
+}
+
+void summary(const char *const *names, int count, string &out)
+{
+	char buf[64];
+	for(int i = 0; i < count; ++i) {
+		Stats st = getStats(getZone(names[i]));
+		snprintf(buf, sizeof(buf), "%s%s %.2f/%.2f", i ? "  " : "", names[i], st.mean, st.p99);
+		out += buf;
+	}
+	out += " ms (mean/p99)";
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+
+#include "Trace.h"
+
+/**
+ * Frame-time profiler with named zones.
+ * Put PROFILE_ZONE("name") at the top of a scope to time it. Zones are also
+ * the events of a Trace recording. While neither the profiler nor a trace
+ * is on, a zone costs two relaxed loads; building with
+ * NO_PROFILER removes zones entirely. Each thread keeps the most recent
+ * samples of each zone without locking or allocating; they are merged when
+ * statistics are asked for, so they follow the current behaviour of the
+ * program.
+ * Time whole passes rather than single items; each sample costs a clock
+ * read and a trace event.
+ */
+namespace Profiler {
+
+	// Samples kept per zone and thread
+	const int WINDOW = 1024;
+	// Zones beyond this many are traced but not profiled
+	const int MAX_ZONES = 64;
+
+	struct Zone
+	{
+		const char *name;
+		int id; // index of the zone's samples in each thread
+	};
+
+	struct Stats
+	{
+		unsigned long count;
+		double min, mean, p99, max; // over the windows of all threads, in ms
+	};
+
+	extern std::atomic<bool> enabled;
+	inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+	void setEnabled(bool e);
+
+	// Zone with this name, created on first use. Zones live until exit.
+	Zone *getZone(const char *name);
+	void record(Zone *zone, double ms);
+	Stats getStats(Zone *zone);
+
+	// Table of all zones that have samples
+	void report(std::ostream &out);
+	// Appends one line of the given zones' means to out, for an overlay.
+	// Does not allocate once out has the capacity.
+	void summary(const char *const *names, int count, std::string &out);
+	
+	// Times its scope into a zone and the trace
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(Zone *zone) :
+			zone(zone),
+			profiling(isEnabled()),
+			tracing(Trace::isRecording())
+		{
+			if(profiling || tracing) {
+				start = std::chrono::steady_clock::now();
+			}
+		}
+		~ScopedTimer()
+		{
+			if(profiling || tracing) {
+				std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+				if(profiling) {
+					record(zone, std::chrono::duration<double, std::milli>(end - start).count());
+				}
+				if(tracing) {
+					Trace::event(zone->name, start, end);
+				}
+			}
+		}
+	private:
+		Zone *zone;
+		bool profiling;
+		bool tracing;
+		std::chrono::steady_clock::time_point start;
+	};
+}
+
+#define PROFILE_CAT2(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT2(a, b)
+#ifdef NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE(name) \
+	static Profiler::Zone *PROFILE_CAT(profileZone, __LINE__) = Profiler::getZone(name); \
+	Profiler::ScopedTimer PROFILE_CAT(profileTimer, __LINE__)(PROFILE_CAT(profileZone, __LINE__))
+#endif
+
+#endif
@@ -2,6 +2,9 @@
 
 #include <iostream>
 #include <cassert>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
 
 #include "GLSL.h"
 
@@ -77,6 +80,15 @@ bool Program::init()
 		return false;
 	}
 	
+	// Variables added before a relink are looked up again
+	for(auto &a : attributeHandles) {
+		attributes[a.second] = glGetAttribLocation(pid, a.first.c_str());
+	}
+	for(auto &u : uniformHandles) {
+		uniforms[u.second].location = glGetUniformLocation(pid, u.first.c_str());
+		uniforms[u.second].size = 0;
+	}
+	
 	GLSL::checkError(GET_FILE_LINE);
 	return true;
 }
@@ -91,36 +103,111 @@ void Program::unbind()
 	glUseProgram(0);
 }
 
-void Program::addAttribute(const string &name)
+int Program::addAttribute(const string &name)
 {
-	attributes[name] = glGetAttribLocation(pid, name.c_str());
+	auto attribute = attributeHandles.find(name);
+	if(attribute != attributeHandles.end()) {
+		return attribute->second;
+	}
+	int handle = (int)attributes.size();
+	attributes.push_back(glGetAttribLocation(pid, name.c_str()));
+	attributeHandles[name] = handle;
+	return handle;
 }
 
-void Program::addUniform(const string &name)
+int Program::addUniform(const string &name)
 {
-	uniforms[name] = glGetUniformLocation(pid, name.c_str());
+	auto uniform = uniformHandles.find(name);
+	if(uniform != uniformHandles.end()) {
+		return uniform->second;
+	}
+	int handle = (int)uniforms.size();
+	Uniform u;
+	u.location = glGetUniformLocation(pid, name.c_str());
+	u.size = 0;
+	uniforms.push_back(u);
+	uniformHandles[name] = handle;
+	return handle;
 }
 
 GLint Program::getAttribute(const string &name) const
 {
-	map<string,GLint>::const_iterator attribute = attributes.find(name.c_str());
-	if(attribute == attributes.end()) {
+	map<string,int>::const_iterator attribute = attributeHandles.find(name);
+	if(attribute == attributeHandles.end()) {
 		if(isVerbose()) {
 			cout << name << " is not an attribute variable" << endl;
 		}
 		return -1;
 	}
-	return attribute->second;
+	return attributes[attribute->second];
 }
 
 GLint Program::getUniform(const string &name) const
 {
-	map<string,GLint>::const_iterator uniform = uniforms.find(name.c_str());
-	if(uniform == uniforms.end()) {
+	map<string,int>::const_iterator uniform = uniformHandles.find(name);
+	if(uniform == uniformHandles.end()) {
 		if(isVerbose()) {
 			cout << name << " is not a uniform variable" << endl;
 		}
 		return -1;
 	}
-	return uniform->second;
+	return uniforms[uniform->second].location;
+}
+
+bool Program::changed(int handle, const void *v, int size)
+{
+	Uniform &u = uniforms[handle];
+	assert(size <= (int)sizeof(u.value));
+	// Values are compared bit for bit, so even NaNs are sent only once
+	if(u.size == size && memcmp(u.value, v, size) == 0) {
+		return false;
+	}
+	memcpy(u.value, v, size);
+	u.size = size;
+	return true;
+}
+
+void Program::invalidateUniforms()
+{
+	for(auto &u : uniforms) {
+		u.size = 0;
+	}
+}
+
+void Program::setUniform(int handle, int v)
+{
+	if(changed(handle, &v, sizeof(v))) {
+		glUniform1i(uniforms[handle].location, v);
+	}
+}
+
+void Program::setUniform(int handle, float v)
+{
+	if(changed(handle, &v, sizeof(v))) {
+		glUniform1f(uniforms[handle].location, v);
+	}
+}
+
+void Program::setUniform(int handle, const glm::vec2 &v)
+{
+	float f[2] = { v.x, v.y };
+	if(changed(handle, f, sizeof(f))) {
+		glUniform2f(uniforms[handle].location, v.x, v.y);
+	}
+}
+
+void Program::setUniform(int handle, const glm::vec3 &v)
+{
+	float f[3] = { v.x, v.y, v.z };
+	if(changed(handle, f, sizeof(f))) {
+		glUniform3f(uniforms[handle].location, v.x, v.y, v.z);
+	}
+}
+
+void Program::setUniform(int handle, const glm::mat4 &v)
+{
+	const float *f = glm::value_ptr(v);
+	if(changed(handle, f, 16*sizeof(float))) {
+		glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, f);
+	}
 }
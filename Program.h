@@ -4,12 +4,21 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
 /**
  * An OpenGL Program (vertex and fragment shaders)
+ * addAttribute() and addUniform() look a variable up once and return a
+ * handle; looking it up again by handle is an array access, by name a map
+ * search. setUniform() remembers the last value of each uniform and skips
+ * the GL call when it is unchanged, so set uniforms only through it; after
+ * setting one with GL directly, call invalidateUniforms().
  */
 class Program
 {
@@ -25,19 +34,42 @@ public:
 	virtual void bind();
 	virtual void unbind();
 
-	void addAttribute(const std::string &name);
-	void addUniform(const std::string &name);
+	int addAttribute(const std::string &name);
+	int addUniform(const std::string &name);
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
+	GLint getAttribute(int handle) const { return attributes[handle]; }
+	GLint getUniform(int handle) const { return uniforms[handle].location; }
+	
+	// Set a uniform of the bound program
+	void setUniform(int handle, int v);
+	void setUniform(int handle, float v);
+	void setUniform(int handle, const glm::vec2 &v);
+	void setUniform(int handle, const glm::vec3 &v);
+	void setUniform(int handle, const glm::mat4 &v);
+	// Forgets the last values, so the next setUniform() of each is sent
+	void invalidateUniforms();
 	
 protected:
 	std::string vShaderName;
 	std::string fShaderName;
 	
 private:
+	struct Uniform
+	{
+		GLint location;
+		int size;        // bytes of the last value, 0 if none was set
+		float value[16]; // last value set
+	};
+	
+	// Whether v differs from the last value of the uniform; remembers it
+	bool changed(int handle, const void *v, int size);
+	
 	GLuint pid;
-	std::map<std::string,GLint> attributes;
-	std::map<std::string,GLint> uniforms;
+	std::map<std::string,int> attributeHandles;
+	std::map<std::string,int> uniformHandles;
+	std::vector<GLint> attributes;
+	std::vector<Uniform> uniforms;
 	bool verbose;
 };
 
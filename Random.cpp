@@ -0,0 +1,161 @@
+#include "Random.h"
+
+#include "Skinning.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RANDOM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define RANDOM_TARGET_AVX2
+#else
+#define RANDOM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace std;
+
+static const uint32_t PHILOX_M0 = 0xD2511F53;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57;
+static const uint32_t PHILOX_W0 = 0x9E3779B9;
+static const uint32_t PHILOX_W1 = 0xBB67AE85;
+
+// 24 random bits to a float in [0, 1). Exact, so the SIMD path matches.
+static inline float toFloat(uint32_t x)
+{
+	return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+Random::Random(uint64_t seed, uint64_t stream) :
+	used(4)
+{
+	key[0] = (uint32_t)seed;
+	key[1] = (uint32_t)(seed >> 32);
+	ctr[0] = 0;
+	ctr[1] = 0;
+	ctr[2] = (uint32_t)stream;
+	ctr[3] = (uint32_t)(stream >> 32);
+}
+
+void Random::philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+{
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for(int r = 0; r < 10; ++r) {
+		uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+		c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+		c1 = (uint32_t)p1;
+		c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+		c3 = (uint32_t)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+void Random::nextBlock()
+{
+	philox(ctr, key, block);
+	if(++ctr[0] == 0) {
+		++ctr[1];
+	}
+	used = 0;
+}
+
+uint32_t Random::nextUint()
+{
+	if(used == 4) {
+		nextBlock();
+	}
+	return block[used++];
+}
+
+float Random::nextFloat()
+{
+	return toFloat(nextUint());
+}
+
+#ifdef RANDOM_X86
+
+// 32x32->64 bit products of the eight lanes of a, split into high and low words
+RANDOM_TARGET_AVX2
+static inline void mulhilo(__m256i a, __m256i m, __m256i &hi, __m256i &lo)
+{
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+	lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+	hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+}
+
+// Eight consecutive blocks starting at ctr, as 32 floats in [l, h)
+RANDOM_TARGET_AVX2
+static void philoxAVX2(const uint32_t ctr[4], const uint32_t key[2], float l, float h, float *out)
+{
+	const __m256i m0 = _mm256_set1_epi32((int)PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32((int)PHILOX_M1);
+	__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int)ctr[0]), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+	__m256i c1 = _mm256_set1_epi32((int)ctr[1]);
+	__m256i c2 = _mm256_set1_epi32((int)ctr[2]);
+	__m256i c3 = _mm256_set1_epi32((int)ctr[3]);
+	uint32_t k0 = key[0], k1 = key[1];
+	for(int r = 0; r < 10; ++r) {
+		__m256i hi0, lo0, hi1, lo1;
+		mulhilo(c0, m0, hi0, lo0);
+		mulhilo(c2, m1, hi1, lo1);
+		c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32((int)k0));
+		c1 = lo1;
+		c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32((int)k1));
+		c3 = lo0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	// To floats in [l, h), as in nextFloat(l, h)
+	const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+	const __m256 vl = _mm256_set1_ps(l);
+	const __m256 vd = _mm256_set1_ps(h - l);
+	__m256 x[4];
+	__m256i c[4] = {c0, c1, c2, c3};
+	for(int w = 0; w < 4; ++w) {
+		__m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c[w], 8)), scale);
+		x[w] = _mm256_add_ps(vl, _mm256_mul_ps(f, vd));
+	}
+	// Transpose from word-major to block-major order
+	__m256 t0 = _mm256_unpacklo_ps(x[0], x[1]);
+	__m256 t1 = _mm256_unpackhi_ps(x[0], x[1]);
+	__m256 t2 = _mm256_unpacklo_ps(x[2], x[3]);
+	__m256 t3 = _mm256_unpackhi_ps(x[2], x[3]);
+	__m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+	__m256 u1 = _mm256_shuffle_ps(t0, t2, 0xee);
+	__m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+	__m256 u3 = _mm256_shuffle_ps(t1, t3, 0xee);
+	_mm256_storeu_ps(out + 0, _mm256_permute2f128_ps(u0, u1, 0x20));
+	_mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(u2, u3, 0x20));
+	_mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(u0, u1, 0x31));
+	_mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(u2, u3, 0x31));
+}
+
+#endif
+
+void Random::fillFloats(float *out, int n, float l, float h)
+{
+	int i = 0;
+	// Finish the current block
+	for(; i < n && used < 4; ++i) {
+		out[i] = nextFloat(l, h);
+	}
+#ifdef RANDOM_X86
+	if(Skinning::detectISA() >= Skinning::AVX2) {
+		// Whole runs of eight blocks, as long as the low counter word does not wrap
+		for(; i + 32 <= n && ctr[0] < 0xfffffff8u; i += 32) {
+			philoxAVX2(ctr, key, l, h, out + i);
+			ctr[0] += 8;
+		}
+	}
+#endif
+	for(; i < n; ++i) {
+		out[i] = nextFloat(l, h);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <cstdint>
+
+/**
+ * Counter-based random numbers (Philox4x32-10, Salmon et al. 2011).
+ * A value depends only on the seed, the stream, and its position in the
+ * stream, so any number of threads can draw from independent streams and
+ * get the same numbers in any order. Each Random object is one stream and
+ * is cheap to create on the stack.
+ */
+class Random
+{
+public:
+	Random(uint64_t seed, uint64_t stream);
+	
+	uint32_t nextUint();
+	// Uniform in [0, 1)
+	float nextFloat();
+	// Uniform in [l, h)
+	float nextFloat(float l, float h) { return l + nextFloat() * (h - l); }
+	// Same values as n calls to nextFloat(l, h), computed with SIMD where available
+	void fillFloats(float *out, int n, float l, float h);
+	
+	// Four random words for a 128-bit counter and a 64-bit key
+	static void philox(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+	
+private:
+	void nextBlock();
+	
+	uint32_t key[2];
+	uint32_t ctr[4];   // ctr[0..1] is the next block, ctr[2..3] the stream
+	uint32_t block[4]; // current block
+	int used;          // words of block already returned
+};
+
+#endif
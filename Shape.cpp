@@ -1,5 +1,7 @@
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <thread>
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
@@ -8,13 +10,23 @@
 #include <Eigen/Dense>
 
 #include "Shape.h"
+#include "Profiler.h"
+#include "Skeleton.h"
+#include "Skinning.h"
+#include "SurfaceSampler.h"
+#include "TextParser.h"
 
 using namespace std;
 using namespace Eigen;
 
-Shape::Shape()
+Shape::Shape() :
+	numVerts(0),
+	offset(0.0f),
+	numBones(0),
+	skinCacheMru(0),
+	skinCacheTick(0)
 {
-
+	setSkinCacheSize(2);
 }
 
 Shape::~Shape()
@@ -22,8 +34,9 @@ Shape::~Shape()
 
 }
 
-void Shape::loadMesh(const string& meshName)
+bool Shape::loadMesh(const string& meshName)
 {
+	PROFILE_ZONE("load.mesh");
 	// Load geometry
 		// This works only if the OBJ file has the same indices for v/n/t.
 		// In other words, the 'f' lines must look like:
@@ -35,12 +48,14 @@ void Shape::loadMesh(const string& meshName)
 	bool rc = tinyobj::LoadObj(&attrib, &shapes, &materials, &errStr, meshName.c_str());
 	if (!rc) {
 		cerr << errStr << endl;
+		return false;
 	}
 	else {
 		posBuf = attrib.vertices;
 		norBuf = attrib.normals;
 		texBuf = attrib.texcoords;
 		assert(posBuf.size() == norBuf.size());
+		triBuf.clear();
 		// Loop over shapes
 		for (size_t s = 0; s < shapes.size(); s++) {
 			// Loop over faces (polygons)
@@ -48,10 +63,11 @@ void Shape::loadMesh(const string& meshName)
 			size_t index_offset = 0;
 			for (size_t f = 0; f < mesh.num_face_vertices.size(); f++) {
 				size_t fv = mesh.num_face_vertices[f];
-				// Loop over vertices in the face.
-				for (size_t v = 0; v < fv; v++) {
-					// access to vertex
-					tinyobj::index_t idx = mesh.indices[index_offset + v];
+				// Loop over vertices in the face, as a fan of triangles
+				for (size_t v = 2; v < fv; v++) {
+					triBuf.push_back(mesh.indices[index_offset].vertex_index);
+					triBuf.push_back(mesh.indices[index_offset + v - 1].vertex_index);
+					triBuf.push_back(mesh.indices[index_offset + v].vertex_index);
 				}
 				index_offset += fv;
 				// per-face material (IGNORE)
@@ -73,6 +89,8 @@ void Shape::loadMesh(const string& meshName)
 
 	// shift mesh to origin
 	offset = max / 2.0;
+	clearSkinCache();
+	return true;
 }
 
 Vector3f Shape::getVertex(int i)
@@ -84,11 +102,239 @@ Vector3f Shape::getVertex(int i)
 
 Vector3f Shape::update(int k, bool isMoving, int vertIndex, int i)
 {
-	// TODO: CPU skinning calculations.
-	// After computing the new positions and normals, send the new data
-	// to the GPU by copying and pasting the relevant code from the
-	// init() function.
+	if (!isMoving)
+	{
+		Vector3f x = getVertex(vertIndex);
+		x(1) = x(1) - offset;
+		return x;
+	}
+
+	// The animation runs slower than the simulation, so the same frame is
+	// requested on several consecutive steps. Each vertex is skinned once per
+	// cached frame.
+	SkinCache *c = getSkinCache(k);
+	unsigned epoch = c->epoch.load(memory_order_relaxed);
+	if (claimVertex(c, epoch, i))
+	{
+		skinVertices(k, i, i + 1, &c->pos[vertIndex]);
+		c->stamp[i].store(epoch, memory_order_release);
+	}
+	else
+	{
+		waitVertex(c, epoch, i);
+	}
+	Vector3f x(c->pos[vertIndex], c->pos[vertIndex + 1], c->pos[vertIndex + 2]);
+	releaseSkinCache(c);
+	return x;
+}
+
+void Shape::skinAll(int k, float *out, float scale)
+{
+	skinRange(k, 0, numVerts, out, scale);
+}
+
+void Shape::skinRange(int k, int begin, int end, float *out, float scale)
+{
+	SkinCache *c = fillCache(k, begin, end);
+	// Kept apart from the skinning so that it vectorizes.
+	const float *src = &c->pos[3 * begin];
+	for (int j = 0; j < 3 * (end - begin); j++) {
+		out[j] = scale * src[j];
+	}
+	releaseSkinCache(c);
+}
+
+void Shape::prepareRange(int k, int begin, int end)
+{
+	releaseSkinCache(fillCache(k, begin, end));
+}
+
+void Shape::skinPoints(int k, const SurfacePoint *points, int count, float *out, float scale)
+{
+	SkinCache *c = getSkinCache(k);
+	const float *pos = c->pos.data();
+	unsigned epoch = c->epoch.load(memory_order_relaxed);
+	for (int p = 0; p < count; p++)
+	{
+		const SurfacePoint &s = points[p];
+		assert(c->stamp[s.v[0]] == epoch && c->stamp[s.v[1]] == epoch && c->stamp[s.v[2]] == epoch);
+		(void)epoch;
+		for (int d = 0; d < 3; d++) {
+			out[3 * p + d] = scale * (s.w[0] * pos[3 * s.v[0] + d] + s.w[1] * pos[3 * s.v[1] + d] + s.w[2] * pos[3 * s.v[2] + d]);
+		}
+	}
+	releaseSkinCache(c);
+}
+
+bool Shape::claimVertex(SkinCache *c, unsigned epoch, int i)
+{
+	unsigned s = c->stamp[i].load(memory_order_relaxed);
+	return s != epoch && s != epoch + 1 &&
+		c->stamp[i].compare_exchange_strong(s, epoch + 1, memory_order_acquire);
+}
+
+void Shape::waitVertex(SkinCache *c, unsigned epoch, int i)
+{
+	while (c->stamp[i].load(memory_order_acquire) != epoch) {
+		this_thread::yield();
+	}
+}
+
+Shape::SkinCache *Shape::fillCache(int k, int begin, int end)
+{
+	SkinCache *c = getSkinCache(k);
+	unsigned epoch = c->epoch.load(memory_order_relaxed);
+	bool busy = false;
+	int i = begin;
+	while (i < end)
+	{
+		// Claim the whole run of stale vertices and skin it in one kernel call
+		int j = i;
+		while (j < end && claimVertex(c, epoch, j)) {
+			j++;
+		}
+		if (j == i)
+		{
+			// Valid, or being skinned by another thread
+			busy = busy || c->stamp[i].load(memory_order_acquire) != epoch;
+			i++;
+			continue;
+		}
+		skinVertices(k, i, j, &c->pos[3 * i]);
+		for (; i < j; i++) {
+			c->stamp[i].store(epoch, memory_order_release);
+		}
+	}
+	// Vertices other threads were skinning must be done before they are read
+	if (busy)
+	{
+		for (i = begin; i < end; i++) {
+			waitVertex(c, epoch, i);
+		}
+	}
+	return c;
+}
+
+void Shape::setSkinCacheSize(int n)
+{
+	lock_guard<mutex> lock(skinCacheMutex);
+	skinCache.clear();
+	for (int s = 0; s < max(n, 2); s++)
+	{
+		auto c = unique_ptr<SkinCache>(new SkinCache());
+		c->frame = -1;
+		c->epoch = 0;
+		c->users = 0;
+		c->lastUse = 0;
+		skinCache.push_back(move(c));
+	}
+	skinCacheMru = 0;
+}
+
+void Shape::clearSkinCache()
+{
+	lock_guard<mutex> lock(skinCacheMutex);
+	for (auto &slot : skinCache)
+	{
+		assert(slot->users == 0);
+		slot->frame = -1;
+		slot->pos.clear();
+	}
+}
+
+Shape::SkinCache *Shape::getSkinCache(int k)
+{
+	// Fast path: every caller of a simulation step asks for the same frame.
+	// The slot is pinned before its frame is checked, and a slot being
+	// recycled loses its frame before its pins are checked, so one of the
+	// two always sees the other.
+	SkinCache *c = skinCache[skinCacheMru.load(memory_order_acquire)].get();
+	c->users.fetch_add(1);
+	if (c->frame.load() == k) {
+		return c;
+	}
+	releaseSkinCache(c);
+
+	for (;;)
+	{
+		{
+			lock_guard<mutex> lock(skinCacheMutex);
+			c = lockSkinCache(k);
+		}
+		if (c) {
+			return c;
+		}
+		// Every other slot is in use, wait until one is released
+		this_thread::yield();
+	}
+}
+
+Shape::SkinCache *Shape::lockSkinCache(int k)
+{
+	for (int s = 0; s < (int)skinCache.size(); s++)
+	{
+		SkinCache *c = skinCache[s].get();
+		if (c->frame.load() == k) {
+			c->users.fetch_add(1);
+			c->lastUse = ++skinCacheTick;
+			skinCacheMru.store(s, memory_order_release);
+			return c;
+		}
+	}
+	// Recycle the least recently used slot nobody is reading
+	int victim = -1;
+	for (int s = 0; s < (int)skinCache.size(); s++)
+	{
+		SkinCache *c = skinCache[s].get();
+		if (c->users.load() == 0 && (victim < 0 || c->lastUse < skinCache[victim]->lastUse)) {
+			victim = s;
+		}
+	}
+	if (victim < 0) {
+		return 0;
+	}
+	SkinCache *c = skinCache[victim].get();
+	int old = c->frame.exchange(-1);
+	if (c->users.load() != 0)
+	{
+		// Pinned by the fast path in the meantime
+		c->frame.store(old);
+		return 0;
+	}
+	if ((int)c->pos.size() != 3 * numVerts)
+	{
+		// Size every slot on first use, so later frames never allocate.
+		// Slots of the wrong size have never been used, nobody reads them.
+		for (auto &slot : skinCache)
+		{
+			if ((int)slot->pos.size() == 3 * numVerts) {
+				continue;
+			}
+			slot->pos.resize(3 * numVerts);
+			slot->stamp.reset(new atomic<unsigned>[numVerts]);
+			for (int i = 0; i < numVerts; i++) {
+				slot->stamp[i] = 0;
+			}
+			slot->epoch = 0;
+		}
+	}
+	// Bumping the epoch invalidates every vertex of the slot at once. Epochs
+	// are even; a stamp of epoch + 1 marks a vertex being skinned.
+	c->epoch.store(c->epoch.load(memory_order_relaxed) + 2, memory_order_relaxed);
+	c->users.fetch_add(1);
+	c->frame.store(k);
+	c->lastUse = ++skinCacheTick;
+	skinCacheMru.store(victim, memory_order_release);
+	return c;
+}
 
+void Shape::releaseSkinCache(SkinCache *c)
+{
+	c->users.fetch_sub(1, memory_order_release);
+}
+
+void Shape::skinVertices(int k, int begin, int end, float *out) const
+{
 	/*
 	for every vertex i to totalVerts
 		x0 = bindPos position at i
@@ -100,115 +346,145 @@ Vector3f Shape::update(int k, bool isMoving, int vertIndex, int i)
 			w = skinning weight at bone j at frame k
 			x += w * Mk * inverse(M0) * x0
 	*/
-	if (isMoving)
-	{
-		//if (k == 30)
-		//{
-		//	cout << endl;
-		//}
-		vector<Matrix4f> products = getProduct(k);
+	Skinning::Batch b;
+	b.rest = posBuf.data();
+	b.offsets = influenceOffsets.data();
+	b.bones = influenceBones.data();
+	b.weights = influenceWeights.data();
+	b.palette = &paletteT[12 * numBones * k];
+	b.numBones = numBones;
+	b.yOffset = offset;
+	b.begin = begin;
+	b.end = end;
+	b.out = out;
+	Skinning::skin(b);
+}
 
-		Vector4f x0(posBuf[vertIndex], posBuf[vertIndex + 1], posBuf[vertIndex + 2], 1.0f);
-		Vector4f n0(norBuf[vertIndex], norBuf[vertIndex + 1], norBuf[vertIndex + 2], 0.0f);
-		vector<int> J = influences[i];
-		vector<float> W = weights[i];
+bool Shape::loadSkeleton(const Skeleton &skeleton)
+{
+	typedef Matrix<float, 3, 4, RowMajor> Matrix34f;
 
-		Vector3f x(0.0f, 0.0f, 0.0f);
-		Vector3f n(0.0f, 0.0f, 0.0f);
+	// The kernels index the palette with the weights' bones unchecked
+	int numInfluences = (int)influenceWeights.size();
+	for (int i = 0; i < numInfluences; i++)
+	{
+		if (influenceBones[i] >= skeleton.getBoneCount()) {
+			cout << "The weights use bone " << influenceBones[i] << ", the skeleton has "
+				<< skeleton.getBoneCount() << " bones" << endl;
+			return false;
+		}
+	}
 
-		for (int j = 0; j < J.size(); j++)
+	// The palette of each animation frame is computed once here, so skinning
+	// a vertex only needs the weighted sum of its influences.
+	clearSkinCache();
+	numBones = skeleton.getBoneCount();
+	int frames = skeleton.getFrameCount();
+	// The only copy: the skinning kernels gather one matrix element for
+	// several bones at once, so the top 3 rows are stored element-major.
+	paletteT.resize(12 * (size_t)numBones * frames);
+	for (int k = 0; k < frames; k++)
+	{
+		float *P = &paletteT[12 * (size_t)numBones * k];
+		for (int j = 0; j < numBones; j++)
 		{
-			int bone = J[j];
-			float wij = W[j];
-
-			Matrix4f M0 = bindPoses[bone];
-			Matrix4f Mk = transformations[k][bone];
-			Matrix4f prod = Mk * M0;
-			//Matrix4f prod = products[bone];
-			// prod(3, 1) = prod(3, 1) - offset;
-			Vector4f xij = wij * prod * x0;
-			Vector4f nij = wij * prod * n0;
-			x += Vector3f(xij(0), xij(1), xij(2));
-			n += Vector3f(nij(0), nij(1), nij(2));
+			Matrix4f M0 = Matrix4f::Identity();
+			M0.topRows<3>() = Map<const Matrix34f>(skeleton.getBindPose(j));
+			Matrix34f Pkj = Map<const Matrix34f>(skeleton.getTransform(k, j)) * M0;
+			for (int e = 0; e < 12; e++) {
+				P[e * numBones + j] = Pkj(e / 4, e % 4);
+			}
 		}
-
-		x(1) = x(1) - offset;
-
-		return x;
 	}
+	return true;
 }
 
-
-std::vector<Eigen::Matrix4f> Shape::getProduct(int k)
+Matrix4f Shape::getProduct(int k, int j) const
 {
-	vector<Matrix4f> products;
-	for (int j = 0; j < bindPoses.size(); j++)
-	{
-		Matrix4f M0 = bindPoses[j];
-		Matrix4f Mk = transformations[k][j];
-		products.push_back(Mk * M0);
+	const float *P = &paletteT[12 * (size_t)numBones * k];
+	Matrix4f M = Matrix4f::Identity();
+	for (int e = 0; e < 12; e++) {
+		M(e / 4, e % 4) = P[e * numBones + j];
 	}
-	return products;
+	return M;
 }
 
-void Shape::parseWeightData(std::string filename)
+bool Shape::parseWeightData(std::string filename)
 {
-	ifstream in;
-	in.open(filename);
-	if (!in.good()) {
+	PROFILE_ZONE("load.weights");
+	influenceOffsets.assign(1, 0);
+	influenceBones.clear();
+	influenceWeights.clear();
+	TextParser in;
+	if (!in.open(filename)) {
 		cout << "Cannot read " << filename << endl;
-		return;
+		return false;
 	}
 	cout << "Loading " << filename << endl;
 
-	string line;
-	int lineIndex = 0, numVertices, numBones, numWeights;
-	while (1)
+	// The skinning kernels trust the weights, so a file that does not match
+	// the mesh is rejected rather than loaded in part.
+	auto reject = [&](const string &msg) {
+		in.error(msg);
+		influenceOffsets.assign(1, 0);
+		influenceBones.clear();
+		influenceWeights.clear();
+		return false;
+	};
+	int lineIndex = 0, numVertices, fileBones, numWeights;
+	while (in.nextLine())
 	{
-		getline(in, line);
-		if (in.eof()) {
-			break;
-		}
-		if (line.empty()) {
-			continue;
-		}
-		// Skip comments
-		if (line.at(0) == '#') {
-			continue;
-		}
-
-		stringstream ss(line);
 		// Parse lines
 		if (lineIndex == 0) {
-
-			ss >> numVertices;
-			ss >> numBones;
-			ss >> numWeights;
+			if (!in.readInt(numVertices) || !in.readInt(fileBones) || !in.readInt(numWeights)) {
+				return reject("expected vertex, bone and weight counts");
+			}
+			if (numVertices < 0 || fileBones < 0 || numWeights < 0) {
+				return reject("negative vertex, bone or weight count");
+			}
+			if (numVertices != numVerts) {
+				return reject(to_string(numVertices) + " vertices, the mesh has " + to_string(numVerts));
+			}
+			fileBones = min(fileBones, 0x10000);
+			influenceOffsets.reserve(numVertices + 1);
+			influenceBones.reserve((size_t)numVertices * numWeights + 1);
+			influenceWeights.reserve((size_t)numVertices * numWeights);
 			lineIndex++;
 			continue;
 		}
+		if ((int)influenceOffsets.size() > numVertices) {
+			return reject("more than " + to_string(numVertices) + " vertices");
+		}
 
 		int numInfluences;
-		ss >> numInfluences;
+		if (!in.readInt(numInfluences) || numInfluences < 0) {
+			return reject("expected an influence count");
+		}
 
-		vector<int> influence;
-		vector<float> weight;
+		// Zero weights contribute nothing, so they are not stored.
 		for (int i = 0; i < numInfluences; i++)
 		{
 			int infl;
 			float wt;
-			ss >> infl;
-			ss >> wt;
-			influence.push_back(infl);
-			weight.push_back(wt);
-		}
-		for (int i = 0; i < (numWeights - numInfluences); i++)
-		{
-			influence.push_back(0);
-			weight.push_back(0);
+			if (!in.readInt(infl) || !in.readFloat(wt)) {
+				return reject("expected " + to_string(numInfluences) + " bone/weight pairs");
+			}
+			if (infl < 0 || infl >= fileBones) {
+				return reject("bone " + to_string(infl) + " out of range");
+			}
+			if (wt == 0.0f) {
+				continue;
+			}
+			influenceBones.push_back((uint16_t)infl);
+			influenceWeights.push_back(wt);
 		}
-
-		this->influences.push_back(influence);
-		this->weights.push_back(weight);
+		influenceOffsets.push_back((int)influenceBones.size());
+	}
+	if ((int)influenceOffsets.size() != numVerts + 1) {
+		return reject(to_string(influenceOffsets.size() - 1) + " vertices, the mesh has " + to_string(numVerts));
 	}
-}
\ No newline at end of file
+	// The SIMD kernels gather bones as 32-bit words, which may read one
+	// element past the last influence.
+	influenceBones.push_back(0);
+	return true;
+}
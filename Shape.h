@@ -5,35 +5,95 @@
 #define EIGEN_DONT_ALIGN_STATICALLY
 #include <Eigen/Dense>
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 
+class Skeleton;
+struct SurfacePoint;
+
 class Shape
 {
 public:
 	Shape(); 
 	virtual ~Shape();
-	void loadMesh(const std::string& meshName);
+	bool loadMesh(const std::string& meshName);
+	// Skinned position of vertex i at frame k, served from the skin cache
 	Eigen::Vector3f update(int k, bool isMoving, int vertIndex, int i);
+	// Skins every vertex at frame k into out (3 floats per vertex), multiplied by scale
+	void skinAll(int k, float *out, float scale);
+	// Same as skinAll for vertices [begin, end); out holds vertex begin first
+	void skinRange(int k, int begin, int end, float *out, float scale);
+	// Skins the vertices [begin, end) at frame k into the skin cache only
+	void prepareRange(int k, int begin, int end);
+	// Skinned positions of surface points at frame k, multiplied by scale.
+	// Their corners must have been prepared for frame k.
+	void skinPoints(int k, const SurfacePoint *points, int count, float *out, float scale);
+	// Number of animation frames whose skinned positions are kept (at least 2)
+	void setSkinCacheSize(int n);
 	int getNumVerts() { return numVerts; }
+	// Rest positions, 3 floats per vertex
+	const std::vector<float> &getPosBuf() const { return posBuf; }
+	// Triangles, 3 vertex indices each
+	const std::vector<int> &getTriBuf() const { return triBuf; }
 	Eigen::Vector3f getVertex(int i);
-	void loadBindPoses(std::vector <Eigen::Matrix4f> binds) { bindPoses = binds; }
-	void loadTransformations(std::vector < std::vector<Eigen::Matrix4f> > transforms) { transformations = transforms; }
-	void parseWeightData(std::string filename);
-	std::vector<Eigen::Matrix4f> getProduct(int k);
+	// Builds the bone palettes of every frame of the skeleton. Fails if the
+	// weights use bones the skeleton does not have.
+	bool loadSkeleton(const Skeleton &skeleton);
+	// Fails unless the file has weights for exactly the vertices of the mesh,
+	// so load the mesh first
+	bool parseWeightData(std::string filename);
+	int getNumBones() const { return numBones; }
+	// Palette matrix of bone j at frame k: transform(k, j) * bindPose(j)
+	Eigen::Matrix4f getProduct(int k, int j) const;
 
 private:
 	std::vector<float> texBuf;
 	std::vector<float> posBuf;
 	std::vector<float> norBuf;
+	std::vector<int> triBuf;
 	int numVerts;
 	float offset;
 
-	std::vector < std::vector<int> > influences;
-	std::vector < std::vector<float> > weights;
-	std::vector < Eigen::Matrix4f > bindPoses;
-	std::vector < std::vector < Eigen::Matrix4f >> transformations;
+	// Influences of vertex i are [influenceOffsets[i], influenceOffsets[i+1])
+	std::vector<int> influenceOffsets;
+	std::vector<uint16_t> influenceBones;
+	std::vector<float> influenceWeights;
+	int numBones;
+	std::vector<float> paletteT; // palettes as transposed 3x4 matrices, 12*numBones floats per frame
+
+	// Skinned positions of one animation frame. Vertices are skinned on first
+	// request; a vertex is valid when its stamp equals the slot's epoch, and
+	// a thread claims it for skinning by setting the stamp to epoch + 1.
+	// Callers pin a slot (users) while they read it so it is not recycled.
+	struct SkinCache
+	{
+		std::atomic<int> frame;
+		std::atomic<unsigned> epoch;
+		std::atomic<int> users;
+		unsigned long lastUse;
+		std::vector<float> pos;
+		std::unique_ptr< std::atomic<unsigned>[] > stamp;
+	};
+	std::vector < std::unique_ptr<SkinCache> > skinCache;
+	std::atomic<int> skinCacheMru;
+	unsigned long skinCacheTick;
+	std::mutex skinCacheMutex;
+
+	// Return the slot of frame k pinned; releaseSkinCache() unpins it
+	SkinCache *getSkinCache(int k);
+	SkinCache *lockSkinCache(int k); // with skinCacheMutex held, 0 if all slots are pinned
+	void releaseSkinCache(SkinCache *c);
+	SkinCache *fillCache(int k, int begin, int end);
+	void clearSkinCache();
+	// Whether this thread now has to skin vertex i
+	bool claimVertex(SkinCache *c, unsigned epoch, int i);
+	// Waits until another thread has skinned vertex i
+	void waitVertex(SkinCache *c, unsigned epoch, int i);
+	void skinVertices(int k, int begin, int end, float *out) const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "SimClock.h"
+
+#include <algorithm>
+
+using namespace std;
+
+SimClock::SimClock(double h, int maxSteps) :
+	h(h),
+	maxSteps(maxSteps),
+	last(0.0),
+	accumulator(0.0),
+	dropped(0.0)
+{
+}
+
+SimClock::~SimClock()
+{
+}
+
+void SimClock::reset(double now)
+{
+	last = now;
+	accumulator = 0.0;
+	dropped = 0.0;
+}
+
+int SimClock::advance(double now)
+{
+	accumulator += max(0.0, now - last);
+	last = now;
+	int steps = (int)(accumulator / h);
+	if(steps > maxSteps) {
+		// Too far behind: run the cap and forget the rest
+		dropped += accumulator - maxSteps*h;
+		steps = maxSteps;
+		accumulator = 0.0;
+	} else {
+		accumulator -= steps*h;
+	}
+	return steps;
+}
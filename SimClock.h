@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _SIMCLOCK_H_
+#define _SIMCLOCK_H_
+
+/**
+ * Fixed-timestep simulation clock.
+ * Wall time is accumulated, and advance() returns how many fixed steps of
+ * size h have to run to catch up. At most maxSteps are run per call; time
+ * beyond that is dropped so a slow frame cannot snowball. getAlpha() is
+ * how far wall time is past the last step, for interpolating the last two
+ * simulation states.
+ */
+class SimClock
+{
+public:
+	SimClock(double h = 0.01, int maxSteps = 8);
+	virtual ~SimClock();
+	
+	void setTimeStep(double h) { this->h = h; }
+	double getTimeStep() const { return h; }
+	void setMaxSteps(int n) { maxSteps = n; }
+	int getMaxSteps() const { return maxSteps; }
+	
+	// Starts counting from the wall time now (in seconds)
+	void reset(double now);
+	// Returns the number of steps to run to reach the wall time now
+	int advance(double now);
+	// Fraction of a step in [0, 1) that wall time is ahead of the simulation
+	float getAlpha() const { return (float)(accumulator / h); }
+	// Wall time dropped because more than maxSteps were due
+	double getDroppedTime() const { return dropped; }
+	
+private:
+	double h;
+	int maxSteps;
+	double last;
+	double accumulator;
+	double dropped;
+};
+
+#endif
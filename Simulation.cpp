@@ -0,0 +1,302 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Shape.h"
+#include "Skeleton.h"
+#include "TextParser.h"
+#include "ThreadPool.h"
+
+using namespace std;
+using namespace Eigen;
+
+// Random streams of the whole show. Particles use their own (see ParticleSystem).
+static const uint64_t STAGGER_STREAM = 1;
+static const uint64_t SAMPLE_STREAM = 2; // plus the shape index
+
+Simulation::Simulation() :
+	skinCacheSize(2),
+	seed(1),
+	stagger(0.0f),
+	particlesPerShape(0),
+	frameCount(0),
+	grav(0.0f, -9.8f, 0.0f),
+	t(0.0f),
+	h(0.01f),
+	frame(0),
+	tFrame(0.0f),
+	held(false)
+{
+}
+
+Simulation::~Simulation()
+{
+}
+
+bool Simulation::load(const string &dataDir)
+{
+	PROFILE_ZONE("load");
+	if(!loadDataInputFile(dataDir + "input.txt")) {
+		return false;
+	}
+	
+	if(dataInput.meshData.empty() || dataInput.skeletonData.empty()) {
+		cout << "input.txt needs a MESH and a SKELETON" << endl;
+		return false;
+	}
+	
+	// Either the text format or a binary file written by tools/skel2bin
+	skeleton = make_shared<Skeleton>();
+	if(!skeleton->load(dataDir + dataInput.skeletonData)) {
+		return false;
+	}
+	if(skeleton->getBoneCount() == 0 || skeleton->getFrameCount() == 0) {
+		cout << dataInput.skeletonData << " has no bones or no frames" << endl;
+		return false;
+	}
+	frameCount = skeleton->getFrameCount();
+	
+	// Create shapes; skinning trusts what they load, so any failure is fatal
+	for(const auto &mesh : dataInput.meshData) {
+		auto shape = make_shared<Shape>();
+		shapes.push_back(shape);
+		if(!shape->loadMesh(dataDir + mesh[0]) || !shape->parseWeightData(dataDir + mesh[1]) ||
+		   !shape->loadSkeleton(*skeleton)) {
+			return false;
+		}
+		shape->setSkinCacheSize(skinCacheSize);
+	}
+	if(!pool) {
+		pool = make_shared<ThreadPool>();
+	}
+	return true;
+}
+
+bool Simulation::loadDataInputFile(const string &filename)
+{
+	PROFILE_ZONE("load.input");
+	TextParser in;
+	if(!in.open(filename)) {
+		cout << "Cannot read " << filename << endl;
+		return false;
+	}
+	cout << "Loading " << filename << endl;
+	
+	while(in.nextLine()) {
+		// Parse lines
+		string key, value;
+		// key
+		in.readWord(key);
+		if(key.compare("TEXTURE") == 0) {
+			if(!in.readWord(value)) {
+				in.error("expected a texture file");
+				continue;
+			}
+			dataInput.textureData.push_back(value);
+		} else if(key.compare("MESH") == 0) {
+			vector<string> mesh(3);
+			// obj, skin, texture
+			if(!in.readWord(mesh[0]) || !in.readWord(mesh[1]) || !in.readWord(mesh[2])) {
+				in.error("expected obj, skin and texture files");
+				continue;
+			}
+			dataInput.meshData.push_back(mesh);
+		} else if(key.compare("SKELETON") == 0) {
+			if(!in.readWord(value)) {
+				in.error("expected a skeleton file");
+				continue;
+			}
+			dataInput.skeletonData = value;
+		} else {
+			in.error("unknown key word: " + key);
+		}
+	}
+	return true;
+}
+
+void Simulation::init(const bool *keyToggles)
+{
+	int n = 0;
+	shapeBase.clear();
+	shapeCount.clear();
+	samples.assign(shapes.size(), vector<SurfacePoint>());
+	for(int j = 0; j < (int)shapes.size(); ++j) {
+		int count = shapes[j]->getNumVerts();
+		if(particlesPerShape > 0) {
+			SurfaceSampler sampler;
+			if(sampler.init(shapes[j]->getPosBuf(), shapes[j]->getTriBuf())) {
+				Random rng(seed, SAMPLE_STREAM + j);
+				sampler.sample(particlesPerShape, rng, samples[j]);
+				count = particlesPerShape;
+			} else {
+				cout << "Shape " << j << " has no surface; using its vertices" << endl;
+			}
+		}
+		shapeBase.push_back(n);
+		shapeCount.push_back(count);
+		n += count;
+	}
+	particles = make_shared<ParticleSystem>();
+	particles->setSeed(seed);
+	particles->init(n);
+	targets.resize(3*n);
+	for(int j = 0; j < (int)shapes.size(); ++j) {
+		float *out = &targets[3*shapeBase[j]];
+		if(samples[j].empty()) {
+			shapes[j]->skinAll(0, out, 1.0f / 100);
+		} else {
+			shapes[j]->prepareRange(0, 0, shapes[j]->getNumVerts());
+			shapes[j]->skinPoints(0, samples[j].data(), shapeCount[j], out, 1.0f / 100);
+		}
+		// The vertex index is the sample index if the shape is sampled
+		for(int v = 0; v < shapeCount[j]; ++v) {
+			int i = shapeBase[j] + v;
+			particles->setShapeIndex(i, j);
+			particles->setVertIndex(i, v);
+		}
+	}
+	// Staggered particles are born up to stagger seconds in the past
+	vector<float> born(n, 0.0f);
+	if(stagger > 0.0f) {
+		Random rng(seed, STAGGER_STREAM);
+		rng.fillFloats(born.data(), n, -stagger, 0.0f);
+	}
+	// Every particle has its own random stream, so births are independent
+	pool->parallelFor(0, n, [&](int begin, int end) {
+		for(int i = begin; i < end; ++i) {
+			Vector3f pos(targets[3*i], targets[3*i+1], targets[3*i+2]);
+			particles->rebirth(i, born[i], keyToggles, pos, Vector3f(0.0f, 1.0f, 0.0f));
+		}
+	});
+	t = 0.0f;
+	// A lifespan fits in the wheel, so particles come out once per life
+	rebirths.init((int)ceil(2.5f / h) + 8, n, 0);
+	due.reserve(n);
+	for(int i = 0; i < n; ++i) {
+		rebirths.schedule(i, getRebirthStep(i, 0));
+	}
+	frame = 0;
+	tFrame = 0.0f;
+	held = false;
+}
+
+bool Simulation::step(const bool *keyToggles)
+{
+	bool explodes = stepParticles(keyToggles);
+	// The animation plays at 30 fps while the particles explode
+	if(explodes && frameCount > 0) {
+		frame = ((int)floor(30 * tFrame)) % frameCount;
+		tFrame += h;
+	} else {
+		frame = 0;
+		tFrame = 0.0f;
+	}
+	return explodes;
+}
+
+bool Simulation::stepParticles(const bool *keyToggles)
+{
+	if(!keyToggles[(unsigned)' ']) {
+		// Paused particles do not move between states either
+		if(!held) {
+			particles->hold();
+			held = true;
+		}
+		return false;
+	}
+	held = false;
+	PROFILE_ZONE("step");
+	int n = particles->size();
+	{
+		PROFILE_ZONE("step.phases");
+		// Particles that die on this step. Estimates are early, so check them.
+		rebirths.take(due);
+		size_t k = 0;
+		for(size_t j = 0; j < due.size(); ++j) {
+			int i = due[j];
+			if(t > particles->getEndTime(i)) {
+				due[k++] = i;
+			} else {
+				rebirths.schedule(i, max(rebirths.getStep(), getRebirthStep(i, rebirths.getStep() - 1)));
+			}
+		}
+		due.resize(k);
+		sort(due.begin(), due.end());
+		particles->updatePhases(t, due);
+	}
+	// Sampled targets blend three vertices that neighbouring chunks may share,
+	// so the vertices of those shapes are skinned in a pass of their own
+	const vector<int> &req = particles->getTargeted();
+	for(int j = 0; j < (int)shapes.size(); ++j) {
+		auto r = lower_bound(req.begin(), req.end(), shapeBase[j]);
+		if(samples[j].empty() || r == req.end() || *r >= shapeBase[j] + shapeCount[j]) {
+			continue;
+		}
+		PROFILE_ZONE("skin.prepare");
+		pool->parallelFor(0, shapes[j]->getNumVerts(), [&](int begin, int end) {
+			shapes[j]->prepareRange(frame, begin, end);
+		});
+	}
+	// Particles are independent, so skin and step them in parallel
+	pool->parallelFor(0, n, [&](int begin, int end) {
+		// Skin the targets this chunk reads, then step it while they are in
+		// cache. Rising particles have no use for theirs. Consecutive
+		// particles are skinned together so the kernels get whole runs.
+		auto r = lower_bound(req.begin(), req.end(), begin);
+		if(r != req.end() && *r < end) {
+			PROFILE_ZONE("skin.chunk");
+			while(r != req.end() && *r < end) {
+				int b = *r, e = b + 1;
+				for(++r; r != req.end() && *r == e && e < end; ++r) {
+					++e;
+				}
+				skinTargets(b, e);
+			}
+		}
+		// Rebirth the dead particles of this chunk
+		auto it = lower_bound(due.begin(), due.end(), begin);
+		for(; it != due.end() && *it < end; ++it) {
+			int i = *it;
+			Vector3f pos(targets[3*i], targets[3*i+1], targets[3*i+2]);
+			particles->rebirth(i, t, keyToggles, pos, Vector3f(0.0f, 1.0f, 0.0f));
+		}
+		particles->stepRange(begin, end, t, h, grav, targets.data());
+	});
+	// As before, the result is whether the last particle is exploding
+	bool explodes = particles->isExploding(n - 1);
+	t += h;
+	for(int i : due) {
+		rebirths.schedule(i, getRebirthStep(i, rebirths.getStep()));
+	}
+	return explodes;
+}
+
+void Simulation::skinTargets(int begin, int end)
+{
+	for(int j = 0; j < (int)shapes.size(); ++j) {
+		int b = max(begin, shapeBase[j]);
+		int e = min(end, shapeBase[j] + shapeCount[j]);
+		if(b >= e) {
+			continue;
+		}
+		if(samples[j].empty()) {
+			shapes[j]->skinRange(frame, b - shapeBase[j], e - shapeBase[j], &targets[3*b], 1.0f / 75);
+		} else {
+			shapes[j]->skinPoints(frame, &samples[j][b - shapeBase[j]], e - b, &targets[3*b], 1.0f / 75);
+		}
+	}
+}
+
+long Simulation::getRebirthStep(int i, long step) const
+{
+	// t is a float sum of steps, so allow for the rounding of each addition
+	float ahead = (particles->getEndTime(i) - t) / h;
+	long margin = 2 + (long)(ahead * (fabs(t) + ahead * h) * FLT_EPSILON / h);
+	return step + max(0L, (long)floor(ahead) - margin);
+}
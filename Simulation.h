@@ -0,0 +1,99 @@
+#pragma once
+#ifndef _SIMULATION_H_
+#define _SIMULATION_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "SurfaceSampler.h"
+#include "TimingWheel.h"
+
+class ParticleSystem;
+class Shape;
+class Skeleton;
+class ThreadPool;
+
+/**
+ * The firework simulation without any window or OpenGL state:
+ * the animated meshes, their skeleton, and the particles that follow them.
+ */
+class Simulation
+{
+public:
+	Simulation();
+	virtual ~Simulation();
+	
+	void setThreadPool(std::shared_ptr<ThreadPool> pool) { this->pool = pool; }
+	// Animation frames of skinned positions kept per shape
+	void setSkinCacheSize(int n) { skinCacheSize = n; }
+	// Seed of the particles' random numbers, applied by init()
+	void setSeed(uint64_t seed) { this->seed = seed; }
+	// Spreads the first deaths, and so all later rebirths, over this many
+	// seconds instead of having every particle die on the same step.
+	// Applied by init(); 0 keeps the original show.
+	void setStagger(float seconds) { stagger = seconds; }
+	// Particles per shape, spread evenly over its surface. 0 puts one
+	// particle on every vertex, as the meshes were authored. Applied by init().
+	void setParticlesPerShape(int n) { particlesPerShape = n; }
+	
+	// Reads dataDir/input.txt and the meshes, skins, and skeleton it lists
+	bool load(const std::string &dataDir);
+	// Spawns one particle per mesh vertex
+	void init(const bool *keyToggles);
+	// Advances by one time step. Returns true while the particles explode.
+	bool step(const bool *keyToggles);
+	
+	float getTime() const { return t; }
+	float getTimeStep() const { return h; }
+	int getFrame() const { return frame; }
+	std::shared_ptr<ParticleSystem> getParticles() const { return particles; }
+	
+private:
+	// Stores information in data/input.txt
+	class DataInput
+	{
+	public:
+		std::vector<std::string> textureData;
+		std::vector< std::vector<std::string> > meshData;
+		std::string skeletonData;
+	};
+	
+	bool loadDataInputFile(const std::string &filename);
+	bool stepParticles(const bool *keyToggles);
+	// Skins the targets of the particles [begin, end)
+	void skinTargets(int begin, int end);
+	// Step on which particle i should be looked at again, never later than its
+	// death, given that the current time t is that of the given step
+	long getRebirthStep(int i, long step) const;
+	
+	DataInput dataInput;
+	std::shared_ptr<ThreadPool> pool;
+	std::shared_ptr<Skeleton> skeleton;
+	std::vector< std::shared_ptr<Shape> > shapes;
+	std::shared_ptr<ParticleSystem> particles;
+	std::vector<int> shapeBase; // index of the first particle of each shape
+	std::vector<int> shapeCount; // number of particles of each shape
+	std::vector< std::vector<SurfacePoint> > samples; // targets of each shape, if sampled
+	std::vector<float> targets; // skinned position each particle is pulled towards
+	TimingWheel rebirths;       // particles by the step they die on
+	std::vector<int> due;       // particles reborn this step, sorted
+	int skinCacheSize;
+	uint64_t seed;
+	float stagger;
+	int particlesPerShape;
+	int frameCount;
+	
+	Eigen::Vector3f grav;
+	float t;      // simulation time
+	float h;      // time step
+	int frame;    // animation frame
+	float tFrame; // time into the animation
+	bool held;    // whether the particles were held still since the last step
+};
+
+#endif
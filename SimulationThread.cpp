@@ -0,0 +1,98 @@
+#include "SimulationThread.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "Profiler.h"
+#include "Simulation.h"
+
+using namespace std;
+
+SimulationThread::SimulationThread(shared_ptr<Simulation> sim) :
+	sim(sim),
+	clock(sim->getTimeStep()),
+	running(false)
+{
+	memset(keys, 0, sizeof(keys));
+	memset(simKeys, 0, sizeof(simKeys));
+}
+
+SimulationThread::~SimulationThread()
+{
+	stop();
+}
+
+double SimulationThread::now() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SimulationThread::start(const bool *keyToggles)
+{
+	setKeyToggles(keyToggles);
+	double t = now();
+	clock.reset(t);
+	// Publish the initial state so the renderer has something to draw
+	ParticleState &s = states.getBack();
+	sim->getParticles()->snapshot(s);
+	s.time = t;
+	states.publish();
+	running = true;
+	thread = std::thread(&SimulationThread::loop, this);
+}
+
+void SimulationThread::stop()
+{
+	running = false;
+	if(thread.joinable()) {
+		thread.join();
+	}
+}
+
+void SimulationThread::setKeyToggles(const bool *keyToggles)
+{
+	lock_guard<mutex> lock(keyMutex);
+	memcpy(keys, keyToggles, sizeof(keys));
+}
+
+const ParticleState &SimulationThread::acquire()
+{
+	states.update();
+	return states.getFront();
+}
+
+float SimulationThread::getAlpha() const
+{
+	const ParticleState &s = states.getFront();
+	double alpha = (now() - s.time) / clock.getTimeStep();
+	return (float)min(max(alpha, 0.0), 1.0);
+}
+
+void SimulationThread::loop()
+{
+	Trace::setThreadName("simulation");
+	while(running) {
+		{
+			lock_guard<mutex> lock(keyMutex);
+			memcpy(simKeys, keys, sizeof(simKeys));
+		}
+		double t = now();
+		int steps = clock.advance(t);
+		if(steps > 0) {
+			PROFILE_ZONE("sim.batch");
+			for(int i = 0; i < steps; ++i) {
+				sim->step(simKeys);
+			}
+			ParticleState &s = states.getBack();
+			sim->getParticles()->snapshot(s);
+			// Wall time at which the newest state was due
+			s.time = t - clock.getAlpha() * clock.getTimeStep();
+			states.publish();
+		} else {
+			// Sleep until the next step is due
+			double wait = (1.0 - clock.getAlpha()) * clock.getTimeStep();
+			this_thread::sleep_for(chrono::duration<double>(wait));
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef _SIMULATIONTHREAD_H_
+#define _SIMULATIONTHREAD_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ParticleSystem.h"
+#include "SimClock.h"
+#include "TripleBuffer.h"
+
+class Simulation;
+
+/**
+ * Runs a Simulation on its own thread, so that the next steps are computed
+ * while the render thread draws and waits for vsync.
+ * After every batch of steps the particle state is published through a
+ * triple buffer; the render thread takes the latest one with acquire().
+ */
+class SimulationThread
+{
+public:
+	SimulationThread(std::shared_ptr<Simulation> sim);
+	virtual ~SimulationThread();
+	
+	SimClock &getClock() { return clock; }
+	// Seconds on the clock shared by both threads
+	double now() const;
+	
+	void start(const bool *keyToggles);
+	void stop();
+	// Copies the key toggles for the next batch of steps
+	void setKeyToggles(const bool *keyToggles);
+	
+	// Latest published state
+	const ParticleState &acquire();
+	// Interpolation factor for drawing the acquired state at time now()
+	float getAlpha() const;
+	
+private:
+	void loop();
+	
+	std::shared_ptr<Simulation> sim;
+	SimClock clock;
+	std::thread thread;
+	std::atomic<bool> running;
+	
+	std::mutex keyMutex;
+	bool keys[256];
+	bool simKeys[256];
+	
+	TripleBuffer<ParticleState> states;
+};
+
+#endif
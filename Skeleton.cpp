@@ -0,0 +1,237 @@
+#include "Skeleton.h"
+#include "Profiler.h"
+#include "TextParser.h"
+
+#include <iostream>
+#include <fstream>
+#include <climits>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+using namespace std;
+using namespace Eigen;
+
+typedef Matrix<float, 3, 4, RowMajor> Matrix34f;
+
+static const char MAGIC[4] = { 'F', 'W', 'S', 'K' };
+
+Skeleton::Skeleton() :
+	boneCount(0),
+	frameCount(0),
+	data(nullptr),
+	mapped(nullptr),
+	mappedSize(0)
+#ifdef _WIN32
+	, mapping(nullptr)
+#endif
+{
+}
+
+Skeleton::~Skeleton()
+{
+	unmap();
+}
+
+bool Skeleton::load(const string &filename)
+{
+	PROFILE_ZONE("load.skeleton");
+	ifstream in(filename, ios::binary);
+	if(!in.good()) {
+		cout << "Cannot read " << filename << endl;
+		return false;
+	}
+	char magic[4] = { 0 };
+	in.read(magic, 4);
+	in.close();
+	if(memcmp(magic, MAGIC, 4) == 0) {
+		return loadBinary(filename);
+	}
+	return loadText(filename);
+}
+
+bool Skeleton::loadText(const string &filename)
+{
+	TextParser in;
+	if(!in.open(filename)) {
+		cout << "Cannot read " << filename << endl;
+		return false;
+	}
+	cout << "Loading " << filename << endl;
+	unmap();
+	owned.clear();
+	boneCount = 0;
+	frameCount = 0;
+	data = nullptr;
+	
+	int lineIndex = 0, headerFrames = 0, bones = 0;
+	while(in.nextLine()) {
+		// Parse lines
+		if(lineIndex == 0) {
+			if(!in.readInt(headerFrames) || !in.readInt(bones) || bones < 0) {
+				in.error("expected frame and bone counts");
+				return false;
+			}
+			owned.reserve(12*(size_t)bones*(headerFrames + 1));
+			lineIndex++;
+			continue;
+		}
+		
+		for(int j = 0; j < bones; ++j) {
+			// quaternion x y z w, then position x y z
+			float f[7];
+			if(!in.readFloats(f, 7)) {
+				in.error("expected 7 floats for bone " + to_string(j));
+				owned.clear();
+				return false;
+			}
+			
+			Quaternionf q(f[3], f[0], f[1], f[2]);
+			q.normalize();
+			Matrix4f M;
+			M.setIdentity();
+			M.block<3,3>(0,0) = Matrix3f(q);
+			M.col(3) = Vector4f(f[4], f[5], f[6], 1.0f);
+			if(lineIndex == 1) {
+				M = M.inverse().eval();
+			}
+			
+			Matrix34f A = M.topRows<3>();
+			owned.insert(owned.end(), A.data(), A.data() + 12);
+		}
+		lineIndex++;
+	}
+	
+	if(lineIndex < 2) {
+		cout << filename << " has no bind pose" << endl;
+		return false;
+	}
+	// The header may promise more frames than the file holds
+	boneCount = bones;
+	frameCount = max(0, min(headerFrames, lineIndex - 2));
+	data = owned.data();
+	return true;
+}
+
+bool Skeleton::loadBinary(const string &filename)
+{
+	unmap();
+	owned.clear();
+	boneCount = 0;
+	frameCount = 0;
+	data = nullptr;
+	size_t size = 0;
+	void *ptr = nullptr;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		cout << "Cannot read " << filename << endl;
+		return false;
+	}
+	LARGE_INTEGER li;
+	GetFileSizeEx(file, &li);
+	size = (size_t)li.QuadPart;
+	HANDLE m = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(m) {
+		ptr = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+		if(!ptr) {
+			CloseHandle(m);
+		} else {
+			mapping = m;
+		}
+	}
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		cout << "Cannot read " << filename << endl;
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0) {
+		size = (size_t)st.st_size;
+		ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(ptr == MAP_FAILED) {
+			ptr = nullptr;
+		}
+	}
+	close(fd);
+#endif
+	if(!ptr) {
+		cout << "Cannot map " << filename << endl;
+		return false;
+	}
+	cout << "Loading " << filename << endl;
+	mapped = ptr;
+	mappedSize = size;
+	
+	const Header *header = (const Header *)mapped;
+	if(size < sizeof(Header) || memcmp(header->magic, MAGIC, 4) != 0 || header->version != VERSION) {
+		cout << filename << " is not a skeleton file of version " << VERSION << endl;
+		unmap();
+		return false;
+	}
+	if(header->boneCount == 0 || header->boneCount > INT_MAX ||
+	   header->frameCount == 0 || header->frameCount > INT_MAX) {
+		cout << filename << " has bad bone or frame counts" << endl;
+		unmap();
+		return false;
+	}
+	// Divided rather than multiplied out, so huge counts cannot wrap
+	size_t perBone = 12*sizeof(float)*((size_t)header->frameCount + 1);
+	if((size - sizeof(Header)) / perBone < header->boneCount) {
+		cout << filename << " is truncated" << endl;
+		unmap();
+		return false;
+	}
+	boneCount = (int)header->boneCount;
+	frameCount = (int)header->frameCount;
+	data = (const float *)(header + 1);
+	return true;
+}
+
+bool Skeleton::saveBinary(const string &filename) const
+{
+	ofstream out(filename, ios::binary);
+	if(!out.good()) {
+		cout << "Cannot write " << filename << endl;
+		return false;
+	}
+	Header header;
+	memcpy(header.magic, MAGIC, 4);
+	header.version = VERSION;
+	header.boneCount = boneCount;
+	header.frameCount = frameCount;
+	out.write((const char *)&header, sizeof(header));
+	out.write((const char *)data, 12*sizeof(float)*(size_t)boneCount*(frameCount + 1));
+	return out.good();
+}
+
+void Skeleton::unmap()
+{
+	if(mapped) {
+#ifdef _WIN32
+		UnmapViewOfFile(mapped);
+		CloseHandle((HANDLE)mapping);
+		mapping = nullptr;
+#else
+		munmap(mapped, mappedSize);
+#endif
+		mapped = nullptr;
+		mappedSize = 0;
+	}
+	data = owned.data();
+	boneCount = 0;
+	frameCount = 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#ifndef _SKELETON_H_
+#define _SKELETON_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Bind poses and animation frames of a skeleton.
+ * Every transform is an affine 3x4 matrix stored row-major (12 floats).
+ * Bind poses are stored already inverted.
+ *
+ * Two file formats are read:
+ * - text: a "frameCount boneCount" line, then one line per pose with
+ *   7 floats per bone (quaternion x y z w, position x y z). The first pose
+ *   is the bind pose.
+ * - binary: a Header followed by boneCount inverse bind poses and
+ *   frameCount * boneCount frame transforms. It is memory-mapped and used
+ *   in place. tools/skel2bin converts text files to it.
+ */
+class Skeleton
+{
+public:
+	struct Header
+	{
+		char magic[4];      // "FWSK"
+		uint32_t version;   // VERSION
+		uint32_t boneCount;
+		uint32_t frameCount;
+	};
+	static const uint32_t VERSION = 1;
+	
+	Skeleton();
+	virtual ~Skeleton();
+	// data points into the skeleton's own storage or mapping, so a copy
+	// would dangle or unmap it twice
+	Skeleton(const Skeleton &) = delete;
+	Skeleton &operator=(const Skeleton &) = delete;
+	
+	// Loads either format, detected from the first bytes of the file
+	bool load(const std::string &filename);
+	bool loadText(const std::string &filename);
+	bool loadBinary(const std::string &filename);
+	bool saveBinary(const std::string &filename) const;
+	
+	int getBoneCount() const { return boneCount; }
+	int getFrameCount() const { return frameCount; }
+	// Inverse bind pose of bone j
+	const float *getBindPose(int j) const { return data + 12*j; }
+	// Transform of bone j at frame k
+	const float *getTransform(int k, int j) const { return data + 12*(boneCount*(k + 1) + j); }
+	
+private:
+	void unmap();
+	
+	int boneCount;
+	int frameCount;
+	const float *data;       // bind poses, then frames
+	std::vector<float> owned; // backing store for text files
+	void *mapped;            // backing store for binary files
+	size_t mappedSize;
+#ifdef _WIN32
+	void *mapping;
+#endif
+};
+
+#endif
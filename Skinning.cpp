@@ -0,0 +1,307 @@
+#include "Skinning.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SKINNING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SKINNING_TARGET_AVX2
+#define SKINNING_TARGET_AVX512
+#else
+#define SKINNING_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SKINNING_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+using namespace std;
+
+namespace Skinning {
+
+#ifdef SKINNING_X86
+#ifdef _MSC_VER
+static ISA cpuidISA()
+{
+	int r[4];
+	__cpuid(r, 0);
+	if(r[0] < 7) {
+		return SCALAR;
+	}
+	__cpuid(r, 1);
+	bool fma = (r[2] & (1 << 12)) != 0;
+	bool osxsave = (r[2] & (1 << 27)) != 0;
+	if(!osxsave) {
+		return SCALAR;
+	}
+	// The OS must save the YMM (and for AVX-512 the ZMM) registers
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(r, 7, 0);
+	bool avx2 = (r[1] & (1 << 5)) != 0;
+	bool avx512f = (r[1] & (1 << 16)) != 0;
+	if(avx512f && (xcr0 & 0xe6) == 0xe6) {
+		return AVX512;
+	}
+	if(avx2 && fma && (xcr0 & 0x6) == 0x6) {
+		return AVX2;
+	}
+	return SCALAR;
+}
+#else
+static ISA cpuidISA()
+{
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		return AVX512;
+	}
+	if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return AVX2;
+	}
+	return SCALAR;
+}
+#endif
+#else
+static ISA cpuidISA()
+{
+	return SCALAR;
+}
+#endif
+
+ISA detectISA()
+{
+	static const ISA isa = cpuidISA();
+	return isa;
+}
+
+static ISA selected = detectISA();
+
+ISA getISA()
+{
+	return selected;
+}
+
+void setISA(ISA isa)
+{
+	selected = min(isa, detectISA());
+}
+
+const char *getISAName(ISA isa)
+{
+	switch(isa) {
+	case AVX2:
+		return "AVX2";
+	case AVX512:
+		return "AVX-512";
+	default:
+		return "scalar";
+	}
+}
+
+void skin(const Batch &b)
+{
+	switch(selected) {
+	case AVX512:
+		skinAVX512(b);
+		break;
+	case AVX2:
+		skinAVX2(b);
+		break;
+	default:
+		skinScalar(b);
+		break;
+	}
+}
+
+// Skins the vertices [begin, end) of b one at a time.
+static void skinScalarRange(const Batch &b, int begin, int end)
+{
+	const float *P = b.palette;
+	int nb = b.numBones;
+	float *out = b.out + 3 * (begin - b.begin);
+	for(int v = begin; v < end; ++v, out += 3) {
+		float x0 = b.rest[3*v+0];
+		float y0 = b.rest[3*v+1];
+		float z0 = b.rest[3*v+2];
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+		for(int w = b.offsets[v]; w < b.offsets[v+1]; ++w) {
+			int j = b.bones[w];
+			float wt = b.weights[w];
+			x += wt * (P[0*nb+j]*x0 + P[1*nb+j]*y0 + P[ 2*nb+j]*z0 + P[ 3*nb+j]);
+			y += wt * (P[4*nb+j]*x0 + P[5*nb+j]*y0 + P[ 6*nb+j]*z0 + P[ 7*nb+j]);
+			z += wt * (P[8*nb+j]*x0 + P[9*nb+j]*y0 + P[10*nb+j]*z0 + P[11*nb+j]);
+		}
+		out[0] = x;
+		out[1] = y - b.yOffset;
+		out[2] = z;
+	}
+}
+
+void skinScalar(const Batch &b)
+{
+	skinScalarRange(b, b.begin, b.end);
+}
+
+#ifdef SKINNING_X86
+
+// Skins the vertices [begin, end) of b one at a time with the same fused
+// operations as a SIMD lane, so that the results of the SIMD kernels do not
+// depend on where a range is split between threads.
+SKINNING_TARGET_AVX2
+static void skinFMARange(const Batch &b, int begin, int end)
+{
+	const float *P = b.palette;
+	int nb = b.numBones;
+	float *out = b.out + 3 * (begin - b.begin);
+	for(int v = begin; v < end; ++v, out += 3) {
+		float x0 = b.rest[3*v+0];
+		float y0 = b.rest[3*v+1];
+		float z0 = b.rest[3*v+2];
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+		for(int w = b.offsets[v]; w < b.offsets[v+1]; ++w) {
+			int j = b.bones[w];
+			float wt = b.weights[w];
+			x = fmaf(wt, fmaf(P[0*nb+j], x0, fmaf(P[1*nb+j], y0, fmaf(P[ 2*nb+j], z0, P[ 3*nb+j]))), x);
+			y = fmaf(wt, fmaf(P[4*nb+j], x0, fmaf(P[5*nb+j], y0, fmaf(P[ 6*nb+j], z0, P[ 7*nb+j]))), y);
+			z = fmaf(wt, fmaf(P[8*nb+j], x0, fmaf(P[9*nb+j], y0, fmaf(P[10*nb+j], z0, P[11*nb+j]))), z);
+		}
+		out[0] = x;
+		out[1] = y - b.yOffset;
+		out[2] = z;
+	}
+}
+
+SKINNING_TARGET_AVX2
+void skinAVX2(const Batch &b)
+{
+	const float *P = b.palette;
+	int nb = b.numBones;
+	const __m256i lane3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+	const __m256 yOffset = _mm256_set1_ps(b.yOffset);
+	const __m256i lo16 = _mm256_set1_epi32(0xffff);
+	const int *bones = (const int *)b.bones;
+	int v = b.begin;
+	for(; v + 8 <= b.end; v += 8) {
+		const float *rest = b.rest + 3*v;
+		__m256 x0 = _mm256_i32gather_ps(rest + 0, lane3, 4);
+		__m256 y0 = _mm256_i32gather_ps(rest + 1, lane3, 4);
+		__m256 z0 = _mm256_i32gather_ps(rest + 2, lane3, 4);
+		__m256 x = _mm256_setzero_ps();
+		__m256 y = _mm256_setzero_ps();
+		__m256 z = _mm256_setzero_ps();
+		// Lanes run the longest influence list of the 8; shorter lists are
+		// masked off and keep bone 0 with weight 0.
+		__m256i first = _mm256_loadu_si256((const __m256i *)(b.offsets + v));
+		__m256i count = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(b.offsets + v + 1)), first);
+		int maxCount = 0;
+		for(int l = 0; l < 8; ++l) {
+			maxCount = max(maxCount, b.offsets[v+l+1] - b.offsets[v+l]);
+		}
+		for(int w = 0; w < maxCount; ++w) {
+			__m256i wv = _mm256_set1_epi32(w);
+			__m256i live = _mm256_cmpgt_epi32(count, wv);
+			__m256i idx = _mm256_add_epi32(first, wv);
+			__m256 wt = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), b.weights, idx, _mm256_castsi256_ps(live), 4);
+			__m256i j = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), bones, idx, live, 2);
+			j = _mm256_and_si256(j, lo16);
+			__m256 r;
+			r = _mm256_i32gather_ps(P + 3*nb, j, 4);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 2*nb, j, 4), z0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 1*nb, j, 4), y0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 0*nb, j, 4), x0, r);
+			x = _mm256_fmadd_ps(wt, r, x);
+			r = _mm256_i32gather_ps(P + 7*nb, j, 4);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 6*nb, j, 4), z0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 5*nb, j, 4), y0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 4*nb, j, 4), x0, r);
+			y = _mm256_fmadd_ps(wt, r, y);
+			r = _mm256_i32gather_ps(P + 11*nb, j, 4);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 10*nb, j, 4), z0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 9*nb, j, 4), y0, r);
+			r = _mm256_fmadd_ps(_mm256_i32gather_ps(P + 8*nb, j, 4), x0, r);
+			z = _mm256_fmadd_ps(wt, r, z);
+		}
+		y = _mm256_sub_ps(y, yOffset);
+		// AVX2 has no scatter, so interleave through the stack
+		alignas(32) float xs[8], ys[8], zs[8];
+		_mm256_store_ps(xs, x);
+		_mm256_store_ps(ys, y);
+		_mm256_store_ps(zs, z);
+		float *out = b.out + 3*(v - b.begin);
+		for(int l = 0; l < 8; ++l) {
+			out[3*l+0] = xs[l];
+			out[3*l+1] = ys[l];
+			out[3*l+2] = zs[l];
+		}
+	}
+	skinFMARange(b, v, b.end);
+}
+
+SKINNING_TARGET_AVX512
+void skinAVX512(const Batch &b)
+{
+	const float *P = b.palette;
+	int nb = b.numBones;
+	const __m512i lane3 = _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45);
+	const __m512 yOffset = _mm512_set1_ps(b.yOffset);
+	const __m512i lo16 = _mm512_set1_epi32(0xffff);
+	int v = b.begin;
+	for(; v + 16 <= b.end; v += 16) {
+		const float *rest = b.rest + 3*v;
+		__m512 x0 = _mm512_i32gather_ps(lane3, rest + 0, 4);
+		__m512 y0 = _mm512_i32gather_ps(lane3, rest + 1, 4);
+		__m512 z0 = _mm512_i32gather_ps(lane3, rest + 2, 4);
+		__m512 x = _mm512_setzero_ps();
+		__m512 y = _mm512_setzero_ps();
+		__m512 z = _mm512_setzero_ps();
+		__m512i first = _mm512_loadu_si512(b.offsets + v);
+		__m512i count = _mm512_sub_epi32(_mm512_loadu_si512(b.offsets + v + 1), first);
+		int maxCount = _mm512_reduce_max_epi32(count);
+		for(int w = 0; w < maxCount; ++w) {
+			__m512i wv = _mm512_set1_epi32(w);
+			__mmask16 live = _mm512_cmpgt_epi32_mask(count, wv);
+			__m512i idx = _mm512_add_epi32(first, wv);
+			__m512 wt = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), live, idx, b.weights, 4);
+			__m512i j = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), live, idx, b.bones, 2);
+			j = _mm512_and_si512(j, lo16);
+			__m512 r;
+			r = _mm512_i32gather_ps(j, P + 3*nb, 4);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 2*nb, 4), z0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 1*nb, 4), y0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 0*nb, 4), x0, r);
+			x = _mm512_fmadd_ps(wt, r, x);
+			r = _mm512_i32gather_ps(j, P + 7*nb, 4);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 6*nb, 4), z0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 5*nb, 4), y0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 4*nb, 4), x0, r);
+			y = _mm512_fmadd_ps(wt, r, y);
+			r = _mm512_i32gather_ps(j, P + 11*nb, 4);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 10*nb, 4), z0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 9*nb, 4), y0, r);
+			r = _mm512_fmadd_ps(_mm512_i32gather_ps(j, P + 8*nb, 4), x0, r);
+			z = _mm512_fmadd_ps(wt, r, z);
+		}
+		y = _mm512_sub_ps(y, yOffset);
+		float *out = b.out + 3*(v - b.begin);
+		_mm512_i32scatter_ps(out + 0, lane3, x, 4);
+		_mm512_i32scatter_ps(out + 1, lane3, y, 4);
+		_mm512_i32scatter_ps(out + 2, lane3, z, 4);
+	}
+	skinFMARange(b, v, b.end);
+}
+
+#else
+
+void skinAVX2(const Batch &b)
+{
+	skinScalar(b);
+}
+
+void skinAVX512(const Batch &b)
+{
+	skinScalar(b);
+}
+
+#endif
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef _SKINNING_H_
+#define _SKINNING_H_
+
+#include <cstdint>
+
+/**
+ * Linear blend skinning kernels.
+ * The best instruction set supported by the CPU is picked at runtime, so the
+ * same binary runs on every host.
+ */
+namespace Skinning {
+
+	// One skinning call over the vertices [begin, end).
+	// The influences of vertex v are [offsets[v], offsets[v+1]) in bones and
+	// weights. bones must have one readable element past the last influence.
+	struct Batch
+	{
+		const float *rest;    // rest positions, 3 floats per vertex
+		const int *offsets;
+		const uint16_t *bones;
+		const float *weights;
+		const float *palette; // transposed 3x4 palette: element e of bone j is palette[e*numBones + j]
+		int numBones;
+		float yOffset;        // subtracted from y after skinning
+		int begin;
+		int end;
+		float *out;           // 3 floats per vertex, out[0] is vertex begin
+	};
+
+	enum ISA {
+		SCALAR = 0,
+		AVX2,
+		AVX512
+	};
+
+	// Best instruction set available on this CPU
+	ISA detectISA();
+	// Instruction set used by skin(); defaults to detectISA()
+	ISA getISA();
+	// Forces an instruction set, e.g. for benchmarks. Clamped to detectISA().
+	void setISA(ISA isa);
+	const char *getISAName(ISA isa);
+
+	void skin(const Batch &b);
+	void skinScalar(const Batch &b);
+	void skinAVX2(const Batch &b);
+	void skinAVX512(const Batch &b);
+}
+
+#endif
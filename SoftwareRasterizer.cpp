@@ -0,0 +1,240 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "ParticleSystem.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Largest sprite in pixels. GL clamps gl_PointSize to its own range, and a
+// particle close to the eye would otherwise overflow the tile arithmetic.
+static const float MAX_POINT_SIZE = 2048.0f;
+
+SoftwareRasterizer::SoftwareRasterizer() :
+	width(0),
+	height(0),
+	tileSize(32),
+	tilesX(0),
+	tilesY(0),
+	background(0.2f, 0.2f, 0.2f),
+	spriteWidth(1),
+	spriteHeight(1)
+{
+	// Until a sprite is loaded, draw solid squares
+	sprite.assign(1, 1.0f);
+	setSize(640, 480);
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+}
+
+void SoftwareRasterizer::setSize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	color.resize(3*width*height);
+	pixels.resize(3*width*height);
+}
+
+bool SoftwareRasterizer::loadSprite(const string &filename)
+{
+	int w, h, ncomps;
+	// Bottom row first, as Texture uploads it
+	stbi_set_flip_vertically_on_load(true);
+	unsigned char *data = stbi_load(filename.c_str(), &w, &h, &ncomps, 0);
+	if(!data) {
+		cerr << filename << " not found" << endl;
+		return false;
+	}
+	spriteWidth = w;
+	spriteHeight = h;
+	sprite.resize(w*h);
+	for(int i = 0; i < w*h; ++i) {
+		sprite[i] = data[i*ncomps] / 255.0f;
+	}
+	stbi_image_free(data);
+	return true;
+}
+
+float SoftwareRasterizer::sampleSprite(float s, float t) const
+{
+	// Bilinear with clamp to edge
+	float x = s*spriteWidth - 0.5f;
+	float y = t*spriteHeight - 0.5f;
+	int x0 = (int)floor(x);
+	int y0 = (int)floor(y);
+	float fx = x - x0;
+	float fy = y - y0;
+	int x1 = min(max(x0 + 1, 0), spriteWidth - 1);
+	int y1 = min(max(y0 + 1, 0), spriteHeight - 1);
+	x0 = min(max(x0, 0), spriteWidth - 1);
+	y0 = min(max(y0, 0), spriteHeight - 1);
+	float a = sprite[y0*spriteWidth + x0]*(1.0f - fx) + sprite[y0*spriteWidth + x1]*fx;
+	float b = sprite[y1*spriteWidth + x0]*(1.0f - fx) + sprite[y1*spriteWidth + x1]*fx;
+	return a*(1.0f - fy) + b*fy;
+}
+
+void SoftwareRasterizer::render(const ParticleSystem &particles, const glm::mat4 &P, const glm::mat4 &MV)
+{
+	PROFILE_ZONE("raster");
+	int n = particles.size();
+	const vector<float> &posBuf = particles.getPosBuf();
+	const vector<float> &scaBuf = particles.getScaBuf();
+	spriteX.resize(n);
+	spriteY.resize(n);
+	spriteSize.resize(n);
+	
+	// Project every particle, as the vertex shader does
+	glm::mat4 PMV = P * MV;
+	float sizeScale = 0.5f * height * P[1][1];
+	auto project = [&](int begin, int end) {
+		for(int i = begin; i < end; ++i) {
+			glm::vec4 c = PMV * glm::vec4(posBuf[3*i], posBuf[3*i+1], posBuf[3*i+2], 1.0f);
+			// Points whose center is outside the view volume are clipped
+			if(c.w <= 0.0f || fabs(c.x) > c.w || fabs(c.y) > c.w || fabs(c.z) > c.w) {
+				spriteSize[i] = 0.0f;
+				continue;
+			}
+			spriteX[i] = (0.5f*c.x/c.w + 0.5f)*width;
+			spriteY[i] = (0.5f*c.y/c.w + 0.5f)*height;
+			// fminf also turns a NaN size into the largest
+			spriteSize[i] = fminf(sizeScale * scaBuf[i] / c.w, MAX_POINT_SIZE);
+		}
+	};
+	if(pool) {
+		pool->parallelFor(0, n, project);
+	} else {
+		project(0, n);
+	}
+	
+	// Bin in particle order so each tile blends in the same order as GL.
+	// The bins are one flat array indexed by a prefix sum of their sizes,
+	// which only allocates when more overlaps than ever before are binned.
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	int tiles = tilesX*tilesY;
+	auto tileRange = [&](int i, int &tx0, int &tx1, int &ty0, int &ty1) {
+		float r = 0.5f*spriteSize[i];
+		if(r <= 0.0f) {
+			return false;
+		}
+		tx0 = max(0, (int)floor((spriteX[i] - r) / tileSize));
+		tx1 = min(tilesX - 1, (int)floor((spriteX[i] + r) / tileSize));
+		ty0 = max(0, (int)floor((spriteY[i] - r) / tileSize));
+		ty1 = min(tilesY - 1, (int)floor((spriteY[i] + r) / tileSize));
+		return true;
+	};
+	binStart.assign(tiles + 1, 0);
+	int tx0, tx1, ty0, ty1;
+	for(int i = 0; i < n; ++i) {
+		if(!tileRange(i, tx0, tx1, ty0, ty1)) {
+			continue;
+		}
+		for(int ty = ty0; ty <= ty1; ++ty) {
+			for(int tx = tx0; tx <= tx1; ++tx) {
+				++binStart[ty*tilesX + tx + 1];
+			}
+		}
+	}
+	for(int tile = 0; tile < tiles; ++tile) {
+		binStart[tile + 1] += binStart[tile];
+	}
+	// Most sprites touch a single tile, so room for four per particle makes
+	// growing rare even at the start
+	binItems.reserve(4*(size_t)n);
+	binItems.resize(binStart[tiles]);
+	binFill.assign(binStart.begin(), binStart.end() - 1);
+	for(int i = 0; i < n; ++i) {
+		if(!tileRange(i, tx0, tx1, ty0, ty1)) {
+			continue;
+		}
+		for(int ty = ty0; ty <= ty1; ++ty) {
+			for(int tx = tx0; tx <= tx1; ++tx) {
+				binItems[binFill[ty*tilesX + tx]++] = i;
+			}
+		}
+	}
+	
+	auto shade = [&](int begin, int end) {
+		for(int tile = begin; tile < end; ++tile) {
+			shadeTile(tile, particles);
+		}
+	};
+	if(pool) {
+		pool->parallelFor(0, tiles, shade);
+	} else {
+		shade(0, tiles);
+	}
+}
+
+void SoftwareRasterizer::shadeTile(int tile, const ParticleSystem &particles)
+{
+	const vector<float> &colBuf = particles.getColBuf();
+	const vector<float> &alpBuf = particles.getAlpBuf();
+	int x0 = (tile % tilesX) * tileSize;
+	int y0 = (tile / tilesX) * tileSize;
+	int x1 = min(x0 + tileSize, width);
+	int y1 = min(y0 + tileSize, height);
+	
+	for(int y = y0; y < y1; ++y) {
+		float *dst = &color[3*(y*width + x0)];
+		for(int x = x0; x < x1; ++x, dst += 3) {
+			dst[0] = background.x;
+			dst[1] = background.y;
+			dst[2] = background.z;
+		}
+	}
+	
+	for(int b = binStart[tile]; b < binStart[tile + 1]; ++b) {
+		int i = binItems[b];
+		float size = spriteSize[i];
+		float left = spriteX[i] - 0.5f*size;
+		float bottom = spriteY[i] - 0.5f*size;
+		// Pixels whose centers fall inside the sprite
+		int px0 = max(x0, (int)ceil(left - 0.5f));
+		int px1 = min(x1, (int)ceil(left + size - 0.5f));
+		int py0 = max(y0, (int)ceil(bottom - 0.5f));
+		int py1 = min(y1, (int)ceil(bottom + size - 0.5f));
+		const float *col = &colBuf[3*i];
+		float alp = alpBuf[i];
+		for(int y = py0; y < py1; ++y) {
+			// gl_PointCoord has its origin at the top left of the sprite
+			float t = 1.0f - (y + 0.5f - bottom) / size;
+			float *dst = &color[3*(y*width + px0)];
+			for(int x = px0; x < px1; ++x, dst += 3) {
+				float s = (x + 0.5f - left) / size;
+				float a = alp * sampleSprite(s, t);
+				dst[0] = col[0]*a + dst[0]*(1.0f - a);
+				dst[1] = col[1]*a + dst[1]*(1.0f - a);
+				dst[2] = col[2]*a + dst[2]*(1.0f - a);
+			}
+		}
+	}
+	
+	for(int y = y0; y < y1; ++y) {
+		for(int x = 3*x0; x < 3*x1; ++x) {
+			float c = min(max(color[3*y*width + x], 0.0f), 1.0f);
+			pixels[3*y*width + x] = (unsigned char)(255.0f*c + 0.5f);
+		}
+	}
+}
+
+bool SoftwareRasterizer::writePNG(const string &filename)
+{
+	// The framebuffer is bottom row first
+	stbi_flip_vertically_on_write(1);
+	if(!stbi_write_png(filename.c_str(), width, height, 3, pixels.data(), 3*width)) {
+		cout << "Cannot write " << filename << endl;
+		return false;
+	}
+	return true;
+}
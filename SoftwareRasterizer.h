@@ -0,0 +1,69 @@
+#pragma once
+#ifndef _SOFTWARERASTERIZER_H_
+#define _SOFTWARERASTERIZER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+class ParticleSystem;
+class ThreadPool;
+
+/**
+ * Draws particles on the CPU the way ParticleRenderer and the sprite shaders
+ * do on the GPU: alpha-blended point sprites in particle order, textured by
+ * the red channel of the sprite image, and sized like
+ *	gl_PointSize = 0.5 * screenSize.y * P[1][1] * aSca / gl_Position.w
+ * The screen is split into tiles. Sprites are binned per tile in particle
+ * order, and tiles are shaded in parallel, so the blend order matches GL.
+ */
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer();
+	virtual ~SoftwareRasterizer();
+	
+	void setThreadPool(std::shared_ptr<ThreadPool> pool) { this->pool = pool; }
+	void setSize(int width, int height);
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	void setTileSize(int t) { tileSize = t; }
+	void setBackground(const glm::vec3 &c) { background = c; }
+	// Loads the sprite texture (3 components, like Texture)
+	bool loadSprite(const std::string &filename);
+	
+	void render(const ParticleSystem &particles, const glm::mat4 &P, const glm::mat4 &MV);
+	bool writePNG(const std::string &filename);
+	
+private:
+	float sampleSprite(float s, float t) const;
+	void shadeTile(int tile, const ParticleSystem &particles);
+	
+	std::shared_ptr<ThreadPool> pool;
+	int width;
+	int height;
+	int tileSize;
+	int tilesX;
+	int tilesY;
+	glm::vec3 background;
+	
+	std::vector<float> sprite; // red channel, bottom row first
+	int spriteWidth;
+	int spriteHeight;
+	
+	// Screen-space sprite of each particle: center and size in pixels.
+	// Culled particles have size 0.
+	std::vector<float> spriteX;
+	std::vector<float> spriteY;
+	std::vector<float> spriteSize;
+	std::vector<int> binStart; // where the particles of each tile start in binItems
+	std::vector<int> binFill;
+	std::vector<int> binItems; // particles overlapping each tile, tile by tile
+	std::vector<float> color;             // RGB, bottom row first like GL
+	std::vector<unsigned char> pixels;
+};
+
+#endif
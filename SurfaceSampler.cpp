@@ -0,0 +1,110 @@
+#include "SurfaceSampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "Random.h"
+
+using namespace std;
+using namespace Eigen;
+
+SurfaceSampler::SurfaceSampler()
+{
+}
+
+SurfaceSampler::~SurfaceSampler()
+{
+}
+
+bool SurfaceSampler::init(const vector<float> &pos, const vector<int> &tris)
+{
+	this->tris = tris;
+	int nt = (int)tris.size() / 3;
+	vector<double> area(nt);
+	double total = 0.0;
+	for(int t = 0; t < nt; ++t) {
+		Map<const Vector3f> a(&pos[3*tris[3*t+0]]);
+		Map<const Vector3f> b(&pos[3*tris[3*t+1]]);
+		Map<const Vector3f> c(&pos[3*tris[3*t+2]]);
+		area[t] = 0.5 * (b - a).cross(c - a).norm();
+		total += area[t];
+	}
+	prob.assign(nt, 1.0f);
+	alias.resize(nt);
+	for(int t = 0; t < nt; ++t) {
+		alias[t] = t;
+	}
+	if(!(total > 0.0)) {
+		prob.clear();
+		alias.clear();
+		return false;
+	}
+	// Vose's alias method: pair each under-full triangle with an over-full one
+	vector<double> p(nt);
+	vector<int> small, large;
+	for(int t = 0; t < nt; ++t) {
+		p[t] = area[t] * nt / total;
+		(p[t] < 1.0 ? small : large).push_back(t);
+	}
+	while(!small.empty() && !large.empty()) {
+		int s = small.back();
+		small.pop_back();
+		int l = large.back();
+		prob[s] = (float)p[s];
+		alias[s] = l;
+		p[l] -= 1.0 - p[s];
+		if(p[l] < 1.0) {
+			large.pop_back();
+			small.push_back(l);
+		}
+	}
+	// Whatever is left is full up to rounding
+	for(int t : small) {
+		prob[t] = 1.0f;
+	}
+	for(int t : large) {
+		prob[t] = 1.0f;
+	}
+	return true;
+}
+
+void SurfaceSampler::sample(int n, Random &rng, vector<SurfacePoint> &out) const
+{
+	out.clear();
+	int nt = getNumTriangles();
+	if(nt == 0) {
+		return;
+	}
+	vector<pair<int, int> > order; // (triangle, point)
+	vector<SurfacePoint> points(n);
+	order.reserve(n);
+	for(int i = 0; i < n; ++i) {
+		// Pick a column of the table from all 32 bits, since a float has too
+		// few to reach every triangle of a large mesh; then toss its coin
+		int t = (int)((uint64_t)rng.nextUint() * nt >> 32);
+		if(rng.nextFloat() >= prob[t]) {
+			t = alias[t];
+		}
+		// Uniform point in the triangle
+		float su = sqrt(rng.nextFloat());
+		float r = rng.nextFloat();
+		SurfacePoint &s = points[i];
+		for(int c = 0; c < 3; ++c) {
+			s.v[c] = tris[3*t+c];
+		}
+		s.w[0] = 1.0f - su;
+		s.w[1] = su * (1.0f - r);
+		s.w[2] = su * r;
+		order.push_back(make_pair(t, i));
+	}
+	// Points of the same triangle share corners, so keep them together
+	sort(order.begin(), order.end());
+	out.reserve(n);
+	for(auto &o : order) {
+		out.push_back(points[o.second]);
+	}
+}
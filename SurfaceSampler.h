@@ -0,0 +1,41 @@
+#pragma once
+#ifndef _SURFACESAMPLER_H_
+#define _SURFACESAMPLER_H_
+
+#include <vector>
+
+class Random;
+
+// A point on a mesh: the weighted sum of three vertices
+struct SurfacePoint
+{
+	int v[3];   // corner vertices
+	float w[3]; // barycentric weights
+};
+
+/**
+ * Draws points uniformly over the area of a triangle mesh.
+ * Triangles are picked in O(1) with an alias table (Vose's method) built
+ * from their areas, so the cost per point does not depend on the mesh.
+ */
+class SurfaceSampler
+{
+public:
+	SurfaceSampler();
+	virtual ~SurfaceSampler();
+	
+	// pos holds 3 floats per vertex, tris 3 vertex indices per triangle.
+	// Returns false if the mesh has no area.
+	bool init(const std::vector<float> &pos, const std::vector<int> &tris);
+	int getNumTriangles() const { return (int)prob.size(); }
+	
+	// Replaces out with n points, ordered by triangle
+	void sample(int n, Random &rng, std::vector<SurfacePoint> &out) const;
+	
+private:
+	std::vector<int> tris;
+	std::vector<float> prob; // chance of keeping triangle t over alias[t]
+	std::vector<int> alias;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "TextParser.h"
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+TextParser::TextParser() :
+	cur(nullptr),
+	lineEnd(nullptr),
+	next(nullptr),
+	lineNumber(0)
+{
+}
+
+TextParser::~TextParser()
+{
+}
+
+bool TextParser::open(const string &filename)
+{
+	this->filename = filename;
+	FILE *f = fopen(filename.c_str(), "rb");
+	if(!f) {
+		return false;
+	}
+	buf.clear();
+	char chunk[1 << 16];
+	size_t n;
+	while((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+		buf.insert(buf.end(), chunk, chunk + n);
+	}
+	fclose(f);
+	cur = lineEnd = next = buf.data();
+	lineNumber = 0;
+	return true;
+}
+
+bool TextParser::nextLine()
+{
+	const char *end = buf.data() + buf.size();
+	while(next < end) {
+		cur = next;
+		lineEnd = cur;
+		while(lineEnd < end && *lineEnd != '\n') {
+			++lineEnd;
+		}
+		next = lineEnd < end ? lineEnd + 1 : end;
+		++lineNumber;
+		skipSpace();
+		// Skip blank lines and comments
+		if(cur < lineEnd && *cur != '#') {
+			return true;
+		}
+	}
+	cur = lineEnd = next;
+	return false;
+}
+
+void TextParser::skipSpace()
+{
+	while(cur < lineEnd && isSpace(*cur)) {
+		++cur;
+	}
+}
+
+bool TextParser::atEndOfLine()
+{
+	skipSpace();
+	return cur >= lineEnd;
+}
+
+bool TextParser::readInt(int &v)
+{
+	skipSpace();
+	const char *first = cur;
+	if(first < lineEnd && *first == '+') {
+		++first;
+	}
+	from_chars_result r = from_chars(first, lineEnd, v);
+	if(r.ec != errc() || (r.ptr < lineEnd && !isSpace(*r.ptr))) {
+		return false;
+	}
+	cur = r.ptr;
+	return true;
+}
+
+bool TextParser::readFloat(float &v)
+{
+	skipSpace();
+	const char *first = cur;
+	if(first < lineEnd && *first == '+') {
+		++first;
+	}
+	from_chars_result r = from_chars(first, lineEnd, v);
+	if(r.ec != errc() || (r.ptr < lineEnd && !isSpace(*r.ptr))) {
+		return false;
+	}
+	cur = r.ptr;
+	return true;
+}
+
+bool TextParser::readFloats(float *v, int n)
+{
+	for(int i = 0; i < n; ++i) {
+		if(!readFloat(v[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TextParser::readWord(string &v)
+{
+	skipSpace();
+	const char *first = cur;
+	while(cur < lineEnd && !isSpace(*cur)) {
+		++cur;
+	}
+	if(cur == first) {
+		return false;
+	}
+	v.assign(first, cur);
+	return true;
+}
+
+void TextParser::error(const string &message) const
+{
+	cerr << filename << ":" << lineNumber << ": " << message << endl;
+}
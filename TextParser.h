@@ -0,0 +1,58 @@
+#pragma once
+#ifndef _TEXTPARSER_H_
+#define _TEXTPARSER_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * Tokenizer for the whitespace-separated text data files.
+ * The whole file is read into one buffer, and numbers are converted with
+ * std::from_chars (locale-independent, no allocation). Blank lines and lines
+ * starting with '#' are skipped.
+ *
+ *	TextParser p;
+ *	if(!p.open(filename)) return;
+ *	while(p.nextLine()) {
+ *		int n;
+ *		if(!p.readInt(n)) { p.error("expected a count"); ... }
+ *	}
+ */
+class TextParser
+{
+public:
+	TextParser();
+	virtual ~TextParser();
+	
+	bool open(const std::string &filename);
+	const std::string &getFilename() const { return filename; }
+	
+	// Moves to the next line with content; false at the end of the file
+	bool nextLine();
+	int getLineNumber() const { return lineNumber; }
+	// True when the current line has no more tokens
+	bool atEndOfLine();
+	
+	// Each reads the next token of the current line. On failure they return
+	// false and leave the token in place.
+	bool readInt(int &v);
+	bool readFloat(float &v);
+	bool readWord(std::string &v);
+	// Reads n floats into v
+	bool readFloats(float *v, int n);
+	
+	// Prints "file:line: message"
+	void error(const std::string &message) const;
+	
+private:
+	void skipSpace();
+	
+	std::string filename;
+	std::vector<char> buf;
+	const char *cur;     // next character of the current line
+	const char *lineEnd; // end of the current line
+	const char *next;    // start of the next line
+	int lineNumber;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "Program.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
@@ -66,11 +67,16 @@ void Texture::setWrapModes(GLint wrapS, GLint wrapT)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
 }
 
-void Texture::bind(GLint handle)
+void Texture::bind(Program &prog, int handle)
+{
+	bind();
+	prog.setUniform(handle, (int)unit);
+}
+
+void Texture::bind()
 {
 	glActiveTexture(GL_TEXTURE0 + unit);
 	glBindTexture(GL_TEXTURE_2D, tid);
-	glUniform1i(handle, unit);
 }
 
 void Texture::unbind()
@@ -7,6 +7,8 @@
 
 #include <string>
 
+class Program;
+
 class Texture
 {
 public:
@@ -16,7 +18,11 @@ public:
 	void init();
 	void setUnit(GLint u) { unit = u; }
 	GLint getUnit() const { return unit; }
-	void bind(GLint handle);
+	// Binds to the unit and sets the sampler uniform handle of the bound
+	// program prog, through its uniform cache
+	void bind(Program &prog, int handle);
+	// Binds to the unit only, for programs that keep the sampler set
+	void bind();
 	void unbind();
 	void setWrapModes(GLint wrapS, GLint wrapT); // Must be called after init()
 	
@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#include "Trace.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(int nThreads) :
+	chunkSize(0),
+	generation(0),
+	active(0),
+	quit(false),
+	fn(nullptr),
+	ctx(nullptr),
+	end(0),
+	chunk(1),
+	next(0)
+{
+	if(nThreads <= 0) {
+		nThreads = max(1, (int)thread::hardware_concurrency());
+	}
+	for(int i = 1; i < nThreads; ++i) {
+		workers.push_back(thread(&ThreadPool::loop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		quit = true;
+	}
+	cvWork.notify_all();
+	for(auto &w : workers) {
+		w.join();
+	}
+}
+
+void ThreadPool::run(int begin, int end, RangeFn fn, const void *ctx)
+{
+	if(end <= begin) {
+		return;
+	}
+	int n = end - begin;
+	int c = chunkSize > 0 ? chunkSize : max(1, n / (4 * getNumThreads()));
+	if(workers.empty() || n <= c) {
+		fn(ctx, begin, end);
+		return;
+	}
+	{
+		lock_guard<mutex> lock(mtx);
+		this->fn = fn;
+		this->ctx = ctx;
+		this->end = end;
+		this->chunk = c;
+		next = begin;
+		active = (int)workers.size();
+		++generation;
+	}
+	cvWork.notify_all();
+	// The calling thread takes chunks too
+	work();
+	unique_lock<mutex> lock(mtx);
+	cvDone.wait(lock, [this] { return active == 0; });
+}
+
+void ThreadPool::work()
+{
+	while(true) {
+		int b = next.fetch_add(chunk);
+		if(b >= end) {
+			break;
+		}
+		fn(ctx, b, min(b + chunk, end));
+	}
+}
+
+void ThreadPool::loop()
+{
+	Trace::setThreadName("pool worker");
+	unsigned long seen = 0;
+	while(true) {
+		unique_lock<mutex> lock(mtx);
+		cvWork.wait(lock, [&] { return quit || generation != seen; });
+		if(quit) {
+			return;
+		}
+		seen = generation;
+		lock.unlock();
+		work();
+		lock.lock();
+		if(--active == 0) {
+			cvDone.notify_one();
+		}
+	}
+}
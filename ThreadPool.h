@@ -0,0 +1,66 @@
+#pragma once
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A persistent pool of worker threads.
+ * parallelFor(begin, end, fn) splits [begin, end) into chunks and calls
+ * fn(chunkBegin, chunkEnd) on them from the workers and the calling thread.
+ * It blocks until every chunk is done. Calls must not be nested.
+ */
+class ThreadPool
+{
+public:
+	// nThreads counts the calling thread; 0 means one per hardware thread.
+	ThreadPool(int nThreads = 0);
+	virtual ~ThreadPool();
+	
+	int getNumThreads() const { return (int)workers.size() + 1; }
+	// Number of items per chunk; 0 picks a size from the range length.
+	void setChunkSize(int c) { chunkSize = c; }
+	int getChunkSize() const { return chunkSize; }
+	
+	template<typename F>
+	void parallelFor(int begin, int end, const F &fn)
+	{
+		run(begin, end, &invoke<F>, &fn);
+	}
+	
+private:
+	typedef void (*RangeFn)(const void *ctx, int begin, int end);
+	
+	template<typename F>
+	static void invoke(const void *ctx, int begin, int end)
+	{
+		(*static_cast<const F *>(ctx))(begin, end);
+	}
+	
+	void run(int begin, int end, RangeFn fn, const void *ctx);
+	void work();
+	void loop();
+	
+	std::vector<std::thread> workers;
+	int chunkSize;
+	
+	std::mutex mtx;
+	std::condition_variable cvWork;
+	std::condition_variable cvDone;
+	unsigned long generation;
+	int active;
+	bool quit;
+	
+	// Current job
+	RangeFn fn;
+	const void *ctx;
+	int end;
+	int chunk;
+	std::atomic<int> next;
+};
+
+#endif
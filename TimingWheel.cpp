@@ -0,0 +1,48 @@
+#include "TimingWheel.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+TimingWheel::TimingWheel() :
+	step(0),
+	mask(0)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+}
+
+void TimingWheel::init(int numSlots, int numItems, long step)
+{
+	int n = 1;
+	while(n < numSlots) {
+		n *= 2;
+	}
+	heads.assign(n, -1);
+	links.assign(numItems, -1);
+	this->step = step;
+	mask = n - 1;
+}
+
+void TimingWheel::schedule(int item, long s)
+{
+	assert(s >= step);
+	s = min(s, step + mask);
+	assert(item >= 0 && item < (int)links.size());
+	links[item] = heads[s & mask];
+	heads[s & mask] = item;
+}
+
+void TimingWheel::take(vector<int> &out)
+{
+	out.clear();
+	int &head = heads[step & mask];
+	for(int i = head; i >= 0; i = links[i]) {
+		out.push_back(i);
+	}
+	head = -1;
+	++step;
+}
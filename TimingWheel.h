@@ -0,0 +1,40 @@
+#pragma once
+#ifndef _TIMINGWHEEL_H_
+#define _TIMINGWHEEL_H_
+
+#include <vector>
+
+/**
+ * Timing wheel of integer items keyed by step number.
+ * Scheduling and taking cost O(1) per item, however many items are waiting.
+ * Items are indices below the count given to init(), each scheduled at most
+ * once at a time. Slots are linked lists threaded through a per-item array,
+ * so the wheel never allocates after init().
+ * Steps further ahead than the wheel is long are clamped to its last slot,
+ * so such items come out early and must be checked and rescheduled.
+ */
+class TimingWheel
+{
+public:
+	TimingWheel();
+	virtual ~TimingWheel();
+	
+	// numSlots is rounded up to a power of two. Clears the wheel.
+	void init(int numSlots, int numItems, long step = 0);
+	int getNumSlots() const { return (int)heads.size(); }
+	
+	// Adds item to step, which must not be before the current step
+	void schedule(int item, long step);
+	// Moves the items of the current step into out and advances to the next
+	// step. out does not allocate once it has room for every item.
+	void take(std::vector<int> &out);
+	long getStep() const { return step; }
+	
+private:
+	std::vector<int> heads; // first item of each slot, or -1
+	std::vector<int> links; // next item in the same slot, or -1
+	long step;
+	long mask;
+};
+
+#endif
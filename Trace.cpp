@@ -0,0 +1,151 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace Trace {
+
+atomic<bool> recording(false);
+
+struct Event
+{
+	const char *name;
+	long long begin; // ns since the start of the recording
+	long long duration;
+};
+
+// Written only by its thread, which also clears it when it sees a new
+// recording; size is published with release so write() sees complete events.
+// events is allocated when the thread registers, so recording never allocates.
+struct ThreadBuffer
+{
+	int tid;
+	string name;
+	unique_ptr<Event[]> events;
+	atomic<unsigned> epoch; // recording the events belong to
+	atomic<int> size;
+	atomic<long long> dropped;
+};
+
+static mutex buffersMutex;
+static vector< unique_ptr<ThreadBuffer> > buffers;
+// Each start() begins a new epoch. origin (steady clock ns) is stored before
+// the epoch is published with release, so a writer that acquires an epoch
+// sees its origin; a writer still on an old epoch writes into a buffer that
+// write() ignores.
+static atomic<unsigned> epoch(0);
+static atomic<long long> origin(0);
+
+// Buffers are never freed, so a thread that exits leaves its events behind.
+// Threads register in setThreadName(), or else on their first event.
+static ThreadBuffer *getBuffer()
+{
+	thread_local ThreadBuffer *buffer = nullptr;
+	if(!buffer) {
+		unique_ptr<ThreadBuffer> b(new ThreadBuffer());
+		// Pages are only touched as events are written
+		b->events.reset(new Event[CAPACITY]);
+		lock_guard<mutex> lock(buffersMutex);
+		b->tid = (int)buffers.size();
+		b->name = "thread " + to_string(b->tid);
+		b->epoch = 0;
+		b->size = 0;
+		b->dropped = 0;
+		buffer = b.get();
+		buffers.push_back(move(b));
+	}
+	return buffer;
+}
+
+void start()
+{
+	origin.store(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count(),
+		memory_order_relaxed);
+	epoch.fetch_add(1, memory_order_release);
+	recording.store(true, memory_order_release);
+}
+
+void stop()
+{
+	recording.store(false, memory_order_release);
+}
+
+void setThreadName(const char *name)
+{
+	ThreadBuffer *b = getBuffer();
+	lock_guard<mutex> lock(buffersMutex);
+	b->name = name;
+}
+
+void event(const char *name, chrono::steady_clock::time_point begin, chrono::steady_clock::time_point end)
+{
+	ThreadBuffer *b = getBuffer();
+	// The first event of a recording clears what the thread recorded before
+	unsigned e = epoch.load(memory_order_acquire);
+	if(b->epoch.load(memory_order_relaxed) != e) {
+		b->size.store(0, memory_order_relaxed);
+		b->dropped.store(0, memory_order_relaxed);
+		b->epoch.store(e, memory_order_release);
+	}
+	int n = b->size.load(memory_order_relaxed);
+	if(n == CAPACITY) {
+		b->dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	long long o = origin.load(memory_order_relaxed);
+	Event &ev = b->events[n];
+	ev.name = name;
+	ev.begin = max(0LL, (long long)chrono::duration_cast<chrono::nanoseconds>(begin.time_since_epoch()).count() - o);
+	ev.duration = chrono::duration_cast<chrono::nanoseconds>(end - begin).count();
+	b->size.store(n + 1, memory_order_release);
+}
+
+bool write(const string &filename)
+{
+	ofstream out(filename);
+	if(!out.good()) {
+		cout << "Cannot write " << filename << endl;
+		return false;
+	}
+	lock_guard<mutex> lock(buffersMutex);
+	unsigned current = epoch.load(memory_order_acquire);
+	long long total = 0, dropped = 0;
+	out << fixed << setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for(auto &b : buffers) {
+		out << (first ? "" : ",\n");
+		first = false;
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid
+			<< ",\"args\":{\"name\":\"" << b->name << "\"}}";
+		// Threads that have not traced since start() hold an older recording
+		if(b->epoch.load(memory_order_acquire) != current) {
+			continue;
+		}
+		int n = b->size.load(memory_order_acquire);
+		for(int i = 0; i < n; ++i) {
+			const Event &e = b->events[i];
+			// Timestamps are in microseconds
+			out << ",\n{\"ph\":\"X\",\"name\":\"" << e.name << "\",\"pid\":1,\"tid\":" << b->tid
+				<< ",\"ts\":" << e.begin * 1e-3 << ",\"dur\":" << e.duration * 1e-3 << "}";
+		}
+		total += n;
+		dropped += b->dropped.load(memory_order_relaxed);
+	}
+	out << "\n]}\n";
+	cout << "Wrote " << total << " trace events to " << filename;
+	if(dropped > 0) {
+		cout << " (" << dropped << " dropped, buffers full)";
+	}
+	cout << endl;
+	return true;
+}
+
+}
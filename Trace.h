@@ -0,0 +1,36 @@
+#pragma once
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/**
+ * Timeline recorder writing Chrome trace-event JSON (chrome://tracing,
+ * Perfetto). Every profiler zone becomes an event while recording.
+ * Each thread appends to its own fixed-size buffer without locks; a full
+ * buffer drops events rather than grow.
+ */
+namespace Trace {
+
+	// Events kept per thread and recording
+	const int CAPACITY = 1 << 16;
+
+	extern std::atomic<bool> recording;
+	inline bool isRecording() { return recording.load(std::memory_order_relaxed); }
+	// Starts a new recording. Each thread clears its buffer on its first
+	// event; events of the previous recording still in flight are dropped.
+	void start();
+	void stop();
+	// Writes what was recorded. Call after stop().
+	bool write(const std::string &filename);
+
+	// Name shown for the calling thread. Also allocates the thread's buffer,
+	// so call it when the thread starts and recording will not allocate.
+	void setThreadName(const char *name);
+	// Adds a complete event on the calling thread
+	void event(const char *name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef _TRIPLEBUFFER_H_
+#define _TRIPLEBUFFER_H_
+
+#include <atomic>
+
+/**
+ * Lock-free triple buffer between one writer thread and one reader thread.
+ * The writer fills getBack() and calls publish(). The reader calls update()
+ * and then reads getFront(), which is always the latest complete value.
+ * Neither side ever waits for the other.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() :
+		middle(1),
+		back(2),
+		front(0)
+	{
+	}
+	
+	// Writer side
+	T &getBack() { return slots[back]; }
+	void publish()
+	{
+		back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & INDEX;
+	}
+	
+	// Reader side. Returns true if a newer value was published.
+	bool update()
+	{
+		if(!(middle.load(std::memory_order_relaxed) & DIRTY)) {
+			return false;
+		}
+		front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+	const T &getFront() const { return slots[front]; }
+	
+private:
+	enum { INDEX = 3, DIRTY = 4 };
+	
+	T slots[3];
+	std::atomic<int> middle; // index of the middle slot, DIRTY if unread
+	int back;
+	int front;
+};
+
+#endif
@@ -0,0 +1,85 @@
+// Checks that the simulation's steady state does not allocate.
+// Usage: alloc_check <DATA DIR> [--warmup N] [--steps N] [--threads N]
+//                    [--particles N]
+// DATA DIR is laid out as for A2 (input.txt and the files it lists).
+// Steps the show with the profiler and a trace recording on, and fails if
+// any of the steps after the first warmup steps allocates.
+// Must be built with -DCOUNT_ALLOCATIONS, and fails otherwise. Links with
+// AllocCounter and the GL-free sources: ParticleSystem, Profiler, Random,
+// Shape, Simulation, Skeleton, Skinning, SurfaceSampler, TextParser,
+// ThreadPool, TimingWheel and Trace.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../AllocCounter.h"
+#include "../ParticleSystem.h"
+#include "../Profiler.h"
+#include "../Simulation.h"
+#include "../ThreadPool.h"
+#include "../Trace.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		cout << "Usage: alloc_check <DATA DIR> [--warmup N] [--steps N] [--threads N]" << endl;
+		cout << "                   [--particles N]" << endl;
+		return 1;
+	}
+	if(!AllocCounter::isAvailable()) {
+		cout << "alloc_check must be built with COUNT_ALLOCATIONS" << endl;
+		return 1;
+	}
+	string dataDir = argv[1] + string("/");
+	// Enough steps to see particles die and be reborn after the warmup
+	int warmup = 50, steps = 500, threads = 0, particles = 0;
+	for(int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		if(arg == "--warmup" && i + 1 < argc) {
+			warmup = max(0, atoi(argv[++i]));
+		} else if(arg == "--steps" && i + 1 < argc) {
+			steps = max(1, atoi(argv[++i]));
+		} else if(arg == "--threads" && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if(arg == "--particles" && i + 1 < argc) {
+			particles = max(0, atoi(argv[++i]));
+		} else {
+			cout << "Unknown option: " << arg << endl;
+		}
+	}
+
+	Trace::setThreadName("main");
+	auto pool = make_shared<ThreadPool>(threads);
+	auto sim = make_shared<Simulation>();
+	sim->setThreadPool(pool);
+	sim->setParticlesPerShape(particles);
+	if(!sim->load(dataDir)) {
+		return 1;
+	}
+	bool keys[256] = {false};
+	sim->init(keys);
+	keys[(unsigned)' '] = true;
+	Profiler::setEnabled(true);
+	Trace::start();
+
+	int allocSteps = 0;
+	for(int s = 0; s < warmup + steps; ++s) {
+		unsigned long long allocs = AllocCounter::getCount();
+		sim->step(keys);
+		allocs = AllocCounter::getCount() - allocs;
+		if(s >= warmup && allocs > 0) {
+			if(allocSteps++ < 10) {
+				cout << "Step " << s << " allocated " << allocs << " times" << endl;
+			}
+		}
+	}
+	Trace::stop();
+	cout << steps << " steps of " << sim->getParticles()->size() << " particles after " << warmup
+		<< " warmup steps: " << allocSteps << " allocated memory" << endl;
+	return allocSteps > 0 ? 1 : 0;
+}
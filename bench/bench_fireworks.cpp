@@ -0,0 +1,401 @@
+// Microbenchmarks of the simulation's hot paths, without OpenGL.
+// Usage: bench_fireworks <DATA DIR> [--reps N] [--warmup N] [--filter TEXT]
+//                        [--json FILE] [--threads N] [--particles N]
+// DATA DIR is laid out as for A2 (input.txt and the files it lists).
+// Each benchmark runs warmup times untimed, then reps timed repetitions,
+// and reports the min, median and p99 time and the median throughput.
+// Links with the GL-free sources: ParticleSystem, Profiler, Random, Shape,
+// Simulation, Skeleton, Skinning, SurfaceSampler, TextParser, ThreadPool,
+// TimingWheel and Trace.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define EIGEN_DONT_ALIGN_STATICALLY
+#include <Eigen/Dense>
+
+#include "../ParticleSystem.h"
+#include "../Random.h"
+#include "../Shape.h"
+#include "../Simulation.h"
+#include "../Skeleton.h"
+#include "../Skinning.h"
+#include "../TextParser.h"
+#include "../ThreadPool.h"
+
+using namespace std;
+using namespace Eigen;
+
+struct Options
+{
+	int reps = 50;
+	int warmup = 5;
+	string filter;
+	string jsonFile;
+	int threads = 0;
+	int particles = 100000;
+};
+
+struct Result
+{
+	string name;
+	long items;
+	double min, median, p99; // ms
+};
+
+static Options opts;
+static vector<Result> results;
+static volatile float sink; // keeps results of benchmarked code alive
+
+// Loaders report each file on cout, which would swamp the timings
+class QuietCout
+{
+public:
+	QuietCout() : old(cout.rdbuf(null.rdbuf())) {}
+	~QuietCout() { cout.rdbuf(old); }
+private:
+	ostringstream null;
+	streambuf *old;
+};
+
+// Times fn, which processes items items per call. setup, if given, runs
+// untimed before every call, to give each the same starting state.
+static void bench(const string &name, long items, const function<void()> &fn,
+	const function<void()> &setup = function<void()>())
+{
+	if(!opts.filter.empty() && name.find(opts.filter) == string::npos) {
+		return;
+	}
+	vector<double> ms;
+	{
+		QuietCout quiet;
+		for(int r = 0; r < opts.warmup; ++r) {
+			if(setup) {
+				setup();
+			}
+			fn();
+		}
+		for(int r = 0; r < opts.reps; ++r) {
+			if(setup) {
+				setup();
+			}
+			auto t0 = chrono::steady_clock::now();
+			fn();
+			ms.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+		}
+	}
+	sort(ms.begin(), ms.end());
+	Result res;
+	res.name = name;
+	res.items = items;
+	res.min = ms.front();
+	res.median = ms[ms.size() / 2];
+	res.p99 = ms[min(ms.size() - 1, (size_t)(0.99 * ms.size()))];
+	results.push_back(res);
+	cout << left << setw(28) << name << right << fixed << setprecision(4)
+		<< setw(12) << res.min << setw(12) << res.median << setw(12) << res.p99
+		<< setw(16) << setprecision(0) << items / (res.median * 1e-3) << endl;
+}
+
+// New empty file in the temporary directory, or "" if none can be made
+static string makeTempFile(const string &prefix)
+{
+#ifdef _WIN32
+	char dir[MAX_PATH], path[MAX_PATH];
+	if(!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, prefix.c_str(), 0, path)) {
+		return "";
+	}
+	return path;
+#else
+	const char *dir = getenv("TMPDIR");
+	string path = string(dir && *dir ? dir : "/tmp") + "/" + prefix + "XXXXXX";
+	int fd = mkstemp(&path[0]);
+	if(fd < 0) {
+		return "";
+	}
+	close(fd);
+	return path;
+#endif
+}
+
+static bool writeJSON(const string &filename)
+{
+	ofstream out(filename);
+	if(!out.good()) {
+		cout << "Cannot write " << filename << endl;
+		return false;
+	}
+	out << "{\n  \"isa\": \"" << Skinning::getISAName(Skinning::detectISA()) << "\",\n"
+		<< "  \"reps\": " << opts.reps << ",\n  \"warmup\": " << opts.warmup << ",\n  \"benchmarks\": [\n";
+	for(size_t i = 0; i < results.size(); ++i) {
+		const Result &r = results[i];
+		out << "    {\"name\": \"" << r.name << "\", \"items\": " << r.items
+			<< ", \"min_ms\": " << r.min << ", \"median_ms\": " << r.median << ", \"p99_ms\": " << r.p99
+			<< ", \"items_per_sec\": " << r.items / (r.median * 1e-3) << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+	cout << "Wrote " << filename << endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		cout << "Usage: bench_fireworks <DATA DIR> [--reps N] [--warmup N] [--filter TEXT]" << endl;
+		cout << "                       [--json FILE] [--threads N] [--particles N]" << endl;
+		return 1;
+	}
+	string dataDir = argv[1] + string("/");
+	for(int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		if(arg == "--reps" && i + 1 < argc) {
+			opts.reps = max(1, atoi(argv[++i]));
+		} else if(arg == "--warmup" && i + 1 < argc) {
+			opts.warmup = max(0, atoi(argv[++i]));
+		} else if(arg == "--filter" && i + 1 < argc) {
+			opts.filter = argv[++i];
+		} else if(arg == "--json" && i + 1 < argc) {
+			opts.jsonFile = argv[++i];
+		} else if(arg == "--threads" && i + 1 < argc) {
+			opts.threads = atoi(argv[++i]);
+		} else if(arg == "--particles" && i + 1 < argc) {
+			opts.particles = max(1, atoi(argv[++i]));
+		} else {
+			cout << "Unknown option: " << arg << endl;
+		}
+	}
+	
+	// The first mesh and the skeleton listed in input.txt
+	string meshFile, weightFile, skeletonFile;
+	TextParser in;
+	if(!in.open(dataDir + "input.txt")) {
+		cout << "Cannot read " << dataDir << "input.txt" << endl;
+		return 1;
+	}
+	while(in.nextLine()) {
+		string key;
+		in.readWord(key);
+		if(key == "MESH" && meshFile.empty()) {
+			in.readWord(meshFile);
+			in.readWord(weightFile);
+		} else if(key == "SKELETON") {
+			in.readWord(skeletonFile);
+		}
+	}
+	if(meshFile.empty() || skeletonFile.empty()) {
+		cout << "input.txt needs a MESH and a SKELETON" << endl;
+		return 1;
+	}
+	meshFile = dataDir + meshFile;
+	weightFile = dataDir + weightFile;
+	skeletonFile = dataDir + skeletonFile;
+	
+	Skeleton skeleton;
+	auto shape = make_shared<Shape>();
+	bool loaded;
+	{
+		QuietCout quiet;
+		loaded = skeleton.load(skeletonFile) && shape->loadMesh(meshFile) &&
+			shape->parseWeightData(weightFile) && shape->loadSkeleton(skeleton);
+	}
+	int nv = shape->getNumVerts();
+	int nb = skeleton.getBoneCount();
+	int nf = skeleton.getFrameCount();
+	if(!loaded || nv == 0 || nf == 0) {
+		cout << "Cannot load the mesh, weights and skeleton of " << dataDir << endl;
+		return 1;
+	}
+	cout << nv << " vertices, " << nb << " bones, " << nf << " frames; "
+		<< "best ISA " << Skinning::getISAName(Skinning::detectISA()) << endl;
+	cout << left << setw(28) << "benchmark" << right << setw(12) << "min ms" << setw(12) << "median ms"
+		<< setw(12) << "p99 ms" << setw(16) << "items/s" << endl;
+	
+	// Parsing and setup
+	bench("load.mesh", nv, [&]() {
+		Shape s;
+		s.loadMesh(meshFile);
+		sink = (float)s.getNumVerts();
+	});
+	// Weights are checked against the mesh, so they are parsed into a loaded one
+	Shape weighted;
+	{
+		QuietCout quiet;
+		weighted.loadMesh(meshFile);
+	}
+	bench("load.weights", nv, [&]() {
+		weighted.parseWeightData(weightFile);
+	});
+	bench("load.skeleton.text", (long)nb * nf, [&]() {
+		Skeleton s;
+		s.loadText(skeletonFile);
+		sink = (float)s.getFrameCount();
+	});
+	// In the temporary directory, as the working directory may be read-only
+	string binaryFile = makeTempFile("fwskb");
+	if(binaryFile.empty()) {
+		cout << "load.skeleton.binary: cannot make a temporary file" << endl;
+	} else if(skeleton.saveBinary(binaryFile)) {
+		bench("load.skeleton.binary", (long)nb * nf, [&]() {
+			Skeleton s;
+			s.loadBinary(binaryFile);
+			sink = (float)s.getFrameCount();
+		});
+	}
+	if(!binaryFile.empty()) {
+		remove(binaryFile.c_str());
+	}
+	bench("shape.loadSkeleton", (long)nb * nf, [&]() {
+		shape->loadSkeleton(skeleton);
+	});
+	bench("shape.getProduct", (long)nb * nf, [&]() {
+		float s = 0.0f;
+		for(int k = 0; k < nf; ++k) {
+			for(int j = 0; j < nb; ++j) {
+				s += shape->getProduct(k, j)(0, 3);
+			}
+		}
+		sink = s;
+	});
+	
+	// Skinning. Frames are cycled through a 2-frame cache so every call skins.
+	vector<float> out(3 * nv);
+	int frame = 0;
+	auto nextFrame = [&]() {
+		frame = (frame + 1) % nf;
+		return frame;
+	};
+	shape->setSkinCacheSize(2);
+	for(int isa = Skinning::SCALAR; isa <= Skinning::detectISA(); ++isa) {
+		Skinning::setISA((Skinning::ISA)isa);
+		string name = string("skin.") + Skinning::getISAName((Skinning::ISA)isa);
+		if(nf < 3) {
+			cout << name << ": needs 3 frames to defeat the cache" << endl;
+			continue;
+		}
+		bench(name, nv, [&]() {
+			shape->skinAll(nextFrame(), out.data(), 1.0f);
+			sink = out[0];
+		});
+	}
+	Skinning::setISA(Skinning::detectISA());
+	bench("skin.cached", nv, [&]() {
+		shape->skinAll(0, out.data(), 1.0f);
+		sink = out[0];
+	});
+	if(nf >= 3) {
+		bench("skin.update", nv, [&]() {
+			int k = nextFrame();
+			float s = 0.0f;
+			for(int i = 0; i < nv; ++i) {
+				s += shape->update(k, true, 3 * i, i)(0);
+			}
+			sink = s;
+		});
+	}
+	
+	// Particles
+	int n = opts.particles;
+	bool keys[256] = {false};
+	ParticleSystem ps;
+	ps.init(n);
+	vector<float> targets(3 * n);
+	{
+		Random rng(1, 1);
+		rng.fillFloats(targets.data(), 3 * n, -1.0f, 1.0f);
+	}
+	Vector3f g(0.0f, -9.8f, 0.0f);
+	Vector3f up(0.0f, 1.0f, 0.0f);
+	bench("particles.rebirth", n, [&]() {
+		for(int i = 0; i < n; ++i) {
+			ps.rebirth(i, 0.0f, keys, Map<Vector3f>(&targets[3 * i]), up);
+		}
+	});
+	vector<int> none, dead;
+	for(int i = 0; i < n; i += 10) {
+		dead.push_back(i);
+	}
+	bench("particles.updatePhases", n, [&]() {
+		ps.updatePhases(0.0f, dead);
+	});
+	// Steps move the particles, so every rep starts from a saved state
+	ps.updatePhases(0.0f, none);
+	ParticleSystem saved(ps);
+	bench("particles.rise", n, [&]() {
+		ps.stepRange(0, n, 0.0f, 0.01f, g, targets.data());
+	}, [&]() {
+		ps = saved;
+	});
+	// Past the explosion time of everyone born at 0
+	ps.updatePhases(2.0f, none);
+	saved = ps;
+	bench("particles.explode", n, [&]() {
+		ps.stepRange(0, n, 2.0f, 0.01f, g, targets.data());
+	}, [&]() {
+		ps = saved;
+	});
+	
+	// Random numbers
+	vector<float> rnd(n);
+	bench("random.nextFloat", n, [&]() {
+		Random rng(1, 2);
+		for(int i = 0; i < n; ++i) {
+			rnd[i] = rng.nextFloat(0.0f, 1.0f);
+		}
+		sink = rnd[0];
+	});
+	bench("random.fillFloats", n, [&]() {
+		Random rng(1, 2);
+		rng.fillFloats(rnd.data(), n, 0.0f, 1.0f);
+		sink = rnd[0];
+	});
+	
+	// A whole step of the simulation, with the particles exploding
+	auto pool = make_shared<ThreadPool>(opts.threads);
+	auto sim = make_shared<Simulation>();
+	sim->setThreadPool(pool);
+	{
+		QuietCout quiet;
+		loaded = sim->load(dataDir);
+		if(loaded) {
+			sim->init(keys);
+		}
+	}
+	if(!loaded) {
+		cout << "Cannot load the simulation of " << dataDir << endl;
+		return 1;
+	}
+	keys[(unsigned)' '] = true;
+	// Every particle explodes from 1.4 s until they are all reborn at 2.4 s,
+	// so the show restarts before it gets close
+	bench("simulation.step", sim->getParticles()->size(), [&]() {
+		sim->step(keys);
+	}, [&]() {
+		if(sim->getTime() < 1.4f || sim->getTime() > 2.3f) {
+			sim->init(keys);
+			while(sim->getTime() < 1.4f) {
+				sim->step(keys);
+			}
+		}
+	});
+	
+	if(!opts.jsonFile.empty() && !writeJSON(opts.jsonFile)) {
+		return 1;
+	}
+	return 0;
+}
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #define _USE_MATH_DEFINES
 #include <cmath>
@@ -14,29 +16,25 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "AllocCounter.h"
 #include "Camera.h"
 #include "GLSL.h"
 #include "MatrixStack.h"
-#include "Particle.h"
+#include "ParticleRenderer.h"
+#include "ParticleSystem.h"
+#include "Profiler.h"
 #include "Program.h"
 #include "Texture.h"
-#include "Shape.h"
+#include "Simulation.h"
+#include "SimulationThread.h"
+#include "SoftwareRasterizer.h"
+#include "Skinning.h"
+#include "ThreadPool.h"
 //#include "WorldShape.h"
 
 using namespace std;
 using namespace Eigen;
 
-// Stores information in data/input.txt
-class DataInput
-{
-public:
-	vector<string> textureData;
-	vector< vector<string> > meshData;
-	string skeletonData;
-};
-
-DataInput dataInput;
-
 GLFWwindow *window; // Main application window
 string RESOURCE_DIR = "./"; // Where the shaders are loaded from
 string DATA_DIR = ""; // where the data are loaded from
@@ -44,17 +42,20 @@ string DATA_DIR = ""; // where the data are loaded from
 shared_ptr<Camera> camera;
 //shared_ptr<WorldShape> plane;
 shared_ptr<Program> prog, prog2;
+// Uniform handles of prog
+struct {
+	int P, MV, screenSize, texture0;
+} progUniforms;
 shared_ptr<Texture> texture0;
-vector< shared_ptr< Particle> > particles;
-vector< shared_ptr<Shape> > shapes;
-vector<Matrix4f> bindPoses;
-vector< vector<Matrix4f> > transformations;
-int frameCount;
-
-Eigen::Vector3f grav;
-float t, h;
+shared_ptr<Simulation> sim;
+shared_ptr<ParticleRenderer> particleRenderer;
+shared_ptr<ThreadPool> pool;
+shared_ptr<SimulationThread> simThread;
+MatrixStack P, MV; // reused by every frame
 
 bool keyToggles[256] = {false}; // only for English keyboards!
+const char *WINDOW_TITLE = "YOUR NAME";
+string traceFile = "trace.json"; // where recorded traces are written
 
 // This function is called when a GLFW error occurs
 static void error_callback(int error, const char *description)
@@ -101,6 +102,44 @@ static void char_callback(GLFWwindow *window, unsigned int key)
 	keyToggles[key] = !keyToggles[key];
 }
 
+// While 'p' is toggled, the window title shows the profiler zones of a frame
+static void updateOverlay()
+{
+	static const char *zones[] = { "step", "skin.prepare", "skin.chunk", "upload", "draw", "swap" };
+	static bool shown = false;
+	static double lastUpdate = 0.0;
+	bool show = keyToggles[(unsigned)'p'];
+	if(show) {
+		Profiler::setEnabled(true);
+		double now = glfwGetTime();
+		if(now - lastUpdate > 0.5) {
+			// Kept so the overlay does not allocate every update
+			static string title;
+			title = WINDOW_TITLE;
+			title += " | ";
+			Profiler::summary(zones, 6, title);
+			glfwSetWindowTitle(window, title.c_str());
+			lastUpdate = now;
+		}
+	} else if(shown) {
+		glfwSetWindowTitle(window, WINDOW_TITLE);
+	}
+	shown = show;
+}
+
+// Toggling 't' starts and stops a trace recording
+static void updateTrace()
+{
+	bool record = keyToggles[(unsigned)'t'];
+	if(record && !Trace::isRecording()) {
+		cout << "Recording trace" << endl;
+		Trace::start();
+	} else if(!record && Trace::isRecording()) {
+		Trace::stop();
+		Trace::write(traceFile);
+	}
+}
+
 // If the window is resized, capture the new size and reset the viewport
 static void resize_callback(GLFWwindow *window, int width, int height)
 {
@@ -110,18 +149,6 @@ static void resize_callback(GLFWwindow *window, int width, int height)
 // This function is called once to initialize the scene and OpenGL
 static void init()
 {
-	// Create shapes
-	for (const auto& mesh : dataInput.meshData) {
-
-			auto shape = make_shared<Shape>();
-			shapes.push_back(shape);
-			shape->loadMesh(DATA_DIR + mesh[0]);
-			shape->parseWeightData(DATA_DIR + mesh[1]);
-			shape->loadBindPoses(bindPoses);
-			shape->loadTransformations(transformations);
-		
-	}
-
 	// Initialize time.
 	glfwSetTime(0.0);
 	
@@ -138,14 +165,10 @@ static void init()
 	prog->setShaderNames(RESOURCE_DIR + "vert.glsl", RESOURCE_DIR + "frag.glsl");
 	prog->setVerbose(true);
 	prog->init();
-	prog->addAttribute("aPos");
-	prog->addAttribute("aAlp");
-	prog->addAttribute("aCol");
-	prog->addAttribute("aSca");
-	prog->addUniform("P");
-	prog->addUniform("MV");
-	prog->addUniform("screenSize");
-	prog->addUniform("texture0");
+	progUniforms.P = prog->addUniform("P");
+	progUniforms.MV = prog->addUniform("MV");
+	progUniforms.screenSize = prog->addUniform("screenSize");
+	progUniforms.texture0 = prog->addUniform("texture0");
 
 	//prog2 = make_shared<Program>();
 	//prog2->setShaderNames(RESOURCE_DIR + "BP_vert.glsl", RESOURCE_DIR + "BP_frag.glsl");
@@ -166,32 +189,18 @@ static void init()
 	texture0->setUnit(0);
 	texture0->setWrapModes(GL_REPEAT, GL_REPEAT);
 	
-	for (int j = 0; j < shapes.size(); j++)
-	{
-		auto shape = shapes[j];
-		int n = shape->getNumVerts();
-		int vertIndex = 0;
-		Particle::init(n);
-		for (int i = 0; i < n; i++) {
-			auto p = make_shared<Particle>(i);
-			p->setShapeindex(j);
-			particles.push_back(p);
-  			Vector3f pos = shapes[0]->update(0, true, vertIndex, i) / 100;
-			p->rebirth(0.0f, keyToggles, pos, Vector3f(0.0f, 1.0f, 0.0f));
-			vertIndex += 3;
-		}
-	}
-
-	grav << 0.0f, -9.8f, 0.0f;
-	t = 0.0f;
-	h = 0.01f;
+	sim->init(keyToggles);
+	particleRenderer = make_shared<ParticleRenderer>();
+	particleRenderer->init(*sim->getParticles(), prog);
 	
 	GLSL::checkError(GET_FILE_LINE);
 }
 
 // This function is called every frame to draw the scene.
-static void render()
+// alpha interpolates the particles between the last two simulation steps.
+static void render(const ParticleState &state, float alpha)
 {
+	PROFILE_ZONE("render");
 	// Clear framebuffer.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	if(keyToggles[(unsigned)'c']) {
@@ -210,223 +219,296 @@ static void render()
 	glfwGetFramebufferSize(window, &width, &height);
 	camera->setAspect((float)width/(float)height);
 	
-	// Matrix stacks
-	auto P = make_shared<MatrixStack>();
-	auto MV = make_shared<MatrixStack>();
-	
 	// Apply camera transforms
-	P->pushMatrix();
-	MV->pushMatrix();
+	P.pushMatrix();
+	MV.pushMatrix();
+	P.loadIdentity();
+	MV.loadIdentity();
 
 	camera->applyViewMatrix(MV);
 	camera->applyProjectionMatrix(P);
 
 	//prog2->bind();
-	//MV->pushMatrix();
-	//MV->scale(100.0f, 1.0f, 100.0f);
-	//MV->rotate(M_PI / 2, 1.0f, 0.0f, 0.0f);
-	//glUniformMatrix4fv(prog2->getUniform("P"), 1, GL_FALSE, glm::value_ptr(P->topMatrix()));
-	//glUniformMatrix4fv(prog2->getUniform("MV"), 1, GL_FALSE, glm::value_ptr(MV->topMatrix()));
-	//glUniformMatrix4fv(prog2->getUniform("MV_it"), 1, GL_FALSE, glm::value_ptr(inverse(transpose((MV->topMatrix())))));
+	//MV.pushMatrix();
+	//MV.scale(100.0f, 1.0f, 100.0f);
+	//MV.rotate(M_PI / 2, 1.0f, 0.0f, 0.0f);
+	//glUniformMatrix4fv(prog2->getUniform("P"), 1, GL_FALSE, glm::value_ptr(P.topMatrix()));
+	//glUniformMatrix4fv(prog2->getUniform("MV"), 1, GL_FALSE, glm::value_ptr(MV.topMatrix()));
+	//glUniformMatrix4fv(prog2->getUniform("MV_it"), 1, GL_FALSE, glm::value_ptr(MV.normalMatrix()));
 	//glUniform3f(prog2->getUniform("kd"), 0.0f, 1.0f, 0.0f);
 	//plane->draw(prog2);
 	//prog2->unbind();
-	//MV->popMatrix();
+	//MV.popMatrix();
 	
 	// Draw particles
 	glEnable(GL_BLEND);
 	glDepthMask(GL_FALSE);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	prog->bind();
-	texture0->bind(prog->getUniform("texture0"));
-	glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, glm::value_ptr(P->topMatrix()));
-	glUniformMatrix4fv(prog->getUniform("MV"), 1, GL_FALSE, glm::value_ptr(MV->topMatrix()));
-	glUniform2f(prog->getUniform("screenSize"), (float)width, (float)height);
-	Particle::draw(particles, prog);
+	// Uniforms that have not changed since the last frame are not sent
+	texture0->bind(*prog, progUniforms.texture0);
+	prog->setUniform(progUniforms.P, P.topMatrix());
+	prog->setUniform(progUniforms.MV, MV.topMatrix());
+	prog->setUniform(progUniforms.screenSize, glm::vec2((float)width, (float)height));
+	particleRenderer->draw(state, alpha);
 	texture0->unbind();
 	prog->unbind();
 	glDepthMask(GL_TRUE);
 	glDisable(GL_BLEND);
 	
-	MV->popMatrix();
-	P->popMatrix();
+	MV.popMatrix();
+	P.popMatrix();
 	
 	GLSL::checkError(GET_FILE_LINE);
 }
 
-bool stepParticles(int frame)
+// Parses "STEP:KEY" where KEY is a character or "space"
+static bool parseKeyEvent(const string &arg, pair<int, unsigned char> &event)
 {
-	if(keyToggles[(unsigned)' ']) {
-		// This can be parallelized!
-		bool explodes = false;
-		int index = 0;
-		double fps = 30;
-
-		for(int i = 0; i < (int)particles.size(); ++i) 
-		{
-			Vector3f pos = shapes[0]->update(frame, true, index, i) / 75;
-			explodes = particles[i]->step(t, h, grav, keyToggles, pos);
-			index += 3;
-		}
-		t += h;
-		return explodes;
+	size_t colon = arg.find(':');
+	if (colon == string::npos || colon + 1 >= arg.size()) {
+		return false;
 	}
-	return false;
+	string key = arg.substr(colon + 1);
+	event.first = atoi(arg.substr(0, colon).c_str());
+	event.second = key == "space" ? ' ' : (unsigned char)key[0];
+	return key == "space" || key.size() == 1;
 }
 
-void loadDataInputFile()
+// Options of the headless batch mode
+struct HeadlessOptions
 {
-	string filename = DATA_DIR + "input.txt";
-	ifstream in;
-	in.open(filename);
-	if (!in.good()) {
-		cout << "Cannot read " << filename << endl;
-		return;
+	int steps = 1000;
+	vector< pair<int, unsigned char> > keyEvents;
+	string statsFile;
+	string dumpFile;
+	string framesDir;   // where PNG frames are written, if set
+	int frameEvery = 1; // steps between frames
+	int width = 640;
+	int height = 480;
+	int allocWarmup = -1; // steps (frames with a window) after which stepping and drawing must not allocate
+};
+
+// Runs the simulation without a window or OpenGL context.
+// Key toggles are scripted: each event flips a key before the given step.
+static int runHeadless(HeadlessOptions opts)
+{
+	int steps = opts.steps;
+	auto &keyEvents = opts.keyEvents;
+	const string &statsFile = opts.statsFile;
+	const string &dumpFile = opts.dumpFile;
+	if (keyEvents.empty()) {
+		keyEvents.push_back(make_pair(0, (unsigned char)' '));
 	}
-	cout << "Loading " << filename << endl;
-
-	string line;
-	while (1) {
-		getline(in, line);
-		if (in.eof()) {
-			break;
-		}
-		if (line.empty()) {
-			continue;
-		}
-		// Skip comments
-		if (line.at(0) == '#') {
-			continue;
-		}
-		// Parse lines
-		string key, value;
-		stringstream ss(line);
-		// key
-		ss >> key;
-		if (key.compare("TEXTURE") == 0) {
-			ss >> value;
-			dataInput.textureData.push_back(value);
-		}
-		else if (key.compare("MESH") == 0) {
-			vector<string> mesh;
-			ss >> value;
-			mesh.push_back(value); // obj
-			ss >> value;
-			mesh.push_back(value); // skin
-			ss >> value;
-			mesh.push_back(value); // texture
-			dataInput.meshData.push_back(mesh);
-		}
-		else if (key.compare("SKELETON") == 0) {
-			ss >> value;
-			dataInput.skeletonData = value;
-		}
-		else {
-			cout << "Unknown key word: " << key << endl;
+	sort(keyEvents.begin(), keyEvents.end());
+	sim->init(keyToggles);
+
+	ofstream stats;
+	if (!statsFile.empty()) {
+		stats.open(statsFile);
+		if (!stats.good()) {
+			cout << "Cannot write " << statsFile << endl;
+			return -1;
 		}
+		stats << "step,t,frame,explodes,ms" << endl;
 	}
-	in.close();
-}
 
-void parseSkeletonData()
-{
-	string filename = DATA_DIR + dataInput.skeletonData;
-	ifstream in;
-	in.open(filename);
-	if (!in.good()) {
-		cout << "Cannot read " << filename << endl;
-		return;
+	// Frames are drawn by the CPU rasterizer from the default camera
+	shared_ptr<SoftwareRasterizer> rasterizer;
+	if (!opts.framesDir.empty()) {
+		rasterizer = make_shared<SoftwareRasterizer>();
+		rasterizer->setThreadPool(pool);
+		rasterizer->setSize(opts.width, opts.height);
+		rasterizer->loadSprite(RESOURCE_DIR + "sphere.jpg");
+		camera = make_shared<Camera>();
+		camera->setInitDistance(10.0f);
+		camera->setAspect((float)opts.width / (float)opts.height);
+		camera->applyProjectionMatrix(P);
+		camera->applyViewMatrix(MV);
 	}
-	cout << "Loading " << filename << endl;
-
-	string line;
-	int lineIndex = 0, boneCount = 0;
-	while (1)
-	{
-		getline(in, line);
-		if (in.eof()) {
-			break;
-		}
-		if (line.empty()) {
-			continue;
-		}
-		// Skip comments
-		if (line.at(0) == '#') {
-			continue;
-		}
-
-		stringstream ss(line);
-		// Parse lines
-		if (lineIndex == 0)
-		{
-			ss >> frameCount;
-			ss >> boneCount;
-			lineIndex++;
-			continue;
-		}
-
-		int i = 0, totalFloats = boneCount * 7;
-		vector<Matrix4f> frameTransform;
-		bool isAnimation = false;
-		while (i < totalFloats)
-		{
-			float x, y, z, w;
-
-			// store quaternion
-			ss >> x;
-			ss >> y;
-			ss >> z;
-			ss >> w;
-
-			Quaternionf q(w, x, y, z);
-
-			// store position
-			ss >> x;
-			ss >> y;
-			ss >> z;
-
-			Vector4f p(x, y, z, 1.0f);
-
-			q.normalize();
-			Matrix3f R(q);
-			Matrix4f M;
-			M.setIdentity();
-			M.block<3, 3>(0, 0) = R;
-			M.col(3) = p;
-
-			if (lineIndex == 1)
-			{
-				bindPoses.push_back(M.inverse());
-			}
-			else
-			{
-				frameTransform.push_back(M);
-				isAnimation = true;
+	int framesWritten = 0;
+	int allocSteps = 0;
+
+	size_t nextEvent = 0;
+	double total = 0.0, worst = 0.0;
+	for (int s = 0; s < steps; s++) {
+		while (nextEvent < keyEvents.size() && keyEvents[nextEvent].first <= s) {
+			unsigned char key = keyEvents[nextEvent++].second;
+			keyToggles[key] = !keyToggles[key];
+		}
+		// Only stepping and drawing count as the steady state, not the output
+		unsigned long long allocs = AllocCounter::getCount();
+		auto t0 = chrono::steady_clock::now();
+		bool explodes = sim->step(keyToggles);
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+		bool frame = rasterizer && s % opts.frameEvery == 0;
+		if (frame) {
+			rasterizer->render(*sim->getParticles(), P.topMatrix(), MV.topMatrix());
+		}
+		allocs = AllocCounter::getCount() - allocs;
+		if (opts.allocWarmup >= 0 && s >= opts.allocWarmup && allocs > 0) {
+			if (allocSteps++ < 10) {
+				cout << "Step " << s << " allocated " << allocs << " times" << endl;
 			}
-			i += 7;
 		}
-		if (isAnimation)
-		{
-			transformations.push_back(frameTransform);
-			frameTransform.clear();
+		total += ms;
+		worst = max(worst, ms);
+		if (stats.is_open()) {
+			stats << s << "," << sim->getTime() << "," << sim->getFrame() << "," << explodes << "," << ms << "\n";
+		}
+		if (frame) {
+			char name[32];
+			snprintf(name, sizeof(name), "/frame_%05d.png", framesWritten++);
+			rasterizer->writePNG(opts.framesDir + name);
+		}
+	}
+	if (rasterizer) {
+		cout << "Wrote " << framesWritten << " frames to " << opts.framesDir << endl;
+	}
+	cout << steps << " steps of " << sim->getParticles()->size() << " particles: "
+		<< total << " ms total, " << (steps > 0 ? total / steps : 0.0) << " ms mean, " << worst << " ms worst" << endl;
+	if (opts.allocWarmup >= 0) {
+		cout << allocSteps << " steps after step " << opts.allocWarmup << " allocated memory" << endl;
+	}
+
+	if (!dumpFile.empty()) {
+		// One particle per line: x y z alpha
+		ofstream out(dumpFile);
+		if (!out.good()) {
+			cout << "Cannot write " << dumpFile << endl;
+			return -1;
+		}
+		const auto &particles = *sim->getParticles();
+		const vector<float> &posBuf = particles.getPosBuf();
+		const vector<float> &alpBuf = particles.getAlpBuf();
+		for (int i = 0; i < particles.size(); i++) {
+			out << posBuf[3 * i] << " " << posBuf[3 * i + 1] << " " << posBuf[3 * i + 2] << " " << alpBuf[i] << "\n";
 		}
-		lineIndex++;
+		cout << "Wrote " << dumpFile << endl;
 	}
-	in.close();
+	return allocSteps > 0 ? -1 : 0;
 }
 
 int main(int argc, char **argv)
 {
 	if (argc < 3) {
-		cout << "Usage: A2 <SHADER DIR> <DATA DIR>" << endl;
+		cout << "Usage: A2 <SHADER DIR> <DATA DIR> [--threads N] [--chunk N] [--skin-cache N]" << endl;
+		cout << "          [--headless] [--steps N] [--key STEP:KEY]... [--stats FILE] [--dump FILE]" << endl;
+		cout << "          [--frames DIR] [--frame-every N] [--size WxH]" << endl;
+		cout << "          [--max-steps N] [--swap-interval N] [--seed N] [--stagger SECONDS]" << endl;
+		cout << "          [--particles N] [--profile] [--trace FILE]" << endl;
+		cout << "          [--check-allocs WARMUP]" << endl;
 		return 0;
 	}
 	RESOURCE_DIR = argv[1] + string("/");
 	DATA_DIR = argv[2] + string("/");
-	loadDataInputFile();
- 	parseSkeletonData();
-
-	double t1 = glfwGetTime();
+	int nThreads = 0, chunkSize = 0, skinCacheSize = 2;
+	bool headless = false;
+	HeadlessOptions opts;
+	int swapInterval = 1, maxSteps = 8;
+	unsigned long long seed = 1;
+	float stagger = 0.0f;
+	int particlesPerShape = 0;
+	for (int i = 3; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			nThreads = atoi(argv[++i]);
+		}
+		else if (arg == "--chunk" && i + 1 < argc) {
+			chunkSize = atoi(argv[++i]);
+		}
+		else if (arg == "--skin-cache" && i + 1 < argc) {
+			skinCacheSize = atoi(argv[++i]);
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		}
+		else if (arg == "--particles" && i + 1 < argc) {
+			particlesPerShape = max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--stagger" && i + 1 < argc) {
+			stagger = (float)atof(argv[++i]);
+		}
+		else if (arg == "--max-steps" && i + 1 < argc) {
+			maxSteps = max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--swap-interval" && i + 1 < argc) {
+			swapInterval = atoi(argv[++i]);
+		}
+		else if (arg == "--trace" && i + 1 < argc) {
+			traceFile = argv[++i];
+			keyToggles[(unsigned)'t'] = true;
+		}
+		else if (arg == "--profile") {
+			Profiler::setEnabled(true);
+		}
+		else if (arg == "--headless") {
+			headless = true;
+		}
+		else if (arg == "--check-allocs" && i + 1 < argc) {
+			opts.allocWarmup = max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--steps" && i + 1 < argc) {
+			opts.steps = atoi(argv[++i]);
+		}
+		else if (arg == "--key" && i + 1 < argc) {
+			pair<int, unsigned char> event;
+			if (!parseKeyEvent(argv[++i], event)) {
+				cout << "Bad key event: " << argv[i] << endl;
+				return -1;
+			}
+			opts.keyEvents.push_back(event);
+		}
+		else if (arg == "--stats" && i + 1 < argc) {
+			opts.statsFile = argv[++i];
+		}
+		else if (arg == "--dump" && i + 1 < argc) {
+			opts.dumpFile = argv[++i];
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			opts.framesDir = argv[++i];
+		}
+		else if (arg == "--frame-every" && i + 1 < argc) {
+			opts.frameEvery = max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--size" && i + 1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &opts.width, &opts.height) != 2) {
+				cout << "Bad size: " << argv[i] << endl;
+				return -1;
+			}
+		}
+		else {
+			cout << "Unknown option: " << arg << endl;
+		}
+	}
+	if (opts.allocWarmup >= 0 && !AllocCounter::isAvailable()) {
+		cout << "--check-allocs needs a build with COUNT_ALLOCATIONS" << endl;
+		return -1;
+	}
+	pool = make_shared<ThreadPool>(nThreads);
+	pool->setChunkSize(chunkSize);
+	cout << "Simulating on " << pool->getNumThreads() << " threads" << endl;
+	cout << "Skinning with " << Skinning::getISAName(Skinning::getISA()) << endl;
+	Trace::setThreadName("main");
+	updateTrace();
+	sim = make_shared<Simulation>();
+	sim->setThreadPool(pool);
+	sim->setSkinCacheSize(skinCacheSize);
+	sim->setSeed(seed);
+	sim->setStagger(stagger);
+	sim->setParticlesPerShape(particlesPerShape);
+	if (!sim->load(DATA_DIR)) {
+		return -1;
+	}
+	if (headless) {
+		int result = runHeadless(opts);
+		keyToggles[(unsigned)'t'] = false;
+		updateTrace();
+		if (Profiler::isEnabled()) {
+			Profiler::report(cout);
+		}
+		return result;
+	}
 
 	// Set error callback.
 	glfwSetErrorCallback(error_callback);
@@ -435,7 +517,7 @@ int main(int argc, char **argv)
 		return -1;
 	}
 	// Create a windowed mode window and its OpenGL context.
-	window = glfwCreateWindow(640, 480, "YOUR NAME", NULL, NULL);
+	window = glfwCreateWindow(640, 480, WINDOW_TITLE, NULL, NULL);
 	if(!window) {
 		glfwTerminate();
 		return -1;
@@ -453,7 +535,7 @@ int main(int argc, char **argv)
 	cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 	GLSL::checkVersion();
 	// Set vsync.
-	glfwSwapInterval(1);
+	glfwSwapInterval(swapInterval);
 	// Set keyboard callback.
 	glfwSetKeyCallback(window, key_callback);
 	// Set char callback.
@@ -467,36 +549,54 @@ int main(int argc, char **argv)
 	// Initialize scene.
 	init();
 
-	bool explodes = false;
-	int frame = 0;
-	float tFrame = 0.0f;
+	// The simulation runs on its own thread at a fixed rate in wall time,
+	// independent of the display refresh rate. Each frame draws the newest
+	// state it has published.
+	simThread = make_shared<SimulationThread>(sim);
+	simThread->getClock().setMaxSteps(maxSteps);
+	simThread->start(keyToggles);
+	// With --check-allocs, frames after the warmup must not allocate. The
+	// count is process-wide, so it covers the simulation thread's steps too.
+	// Turning on the profiler allocates its buffers, so do it in the warmup.
+	int frames = 0, allocFrames = 0;
 	// Loop until the user closes the window.
 	while(!glfwWindowShouldClose(window)) {
-		// Step particles.
-		explodes = stepParticles(frame);
-		
-		if (explodes)
-		{
-			frame = ((int)floor(30 * tFrame)) % frameCount;
-			tFrame += h;
-		}
-		else
-		{
-			frame = 0;
-			tFrame = 0.0f;
-		}
+		unsigned long long allocs = AllocCounter::getCount();
+		PROFILE_ZONE("frame");
+		simThread->setKeyToggles(keyToggles);
 
 		if(!glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
 			// Render scene.
-			render();
+			const ParticleState &state = simThread->acquire();
+			render(state, simThread->getAlpha());
 			// Swap front and back buffers.
+			PROFILE_ZONE("swap");
 			glfwSwapBuffers(window);
 		}
+		updateOverlay();
+		// Writing a trace and handling input are not the steady state
+		allocs = AllocCounter::getCount() - allocs;
+		if (opts.allocWarmup >= 0 && frames >= opts.allocWarmup && allocs > 0) {
+			if (allocFrames++ < 10) {
+				cout << "Frame " << frames << " allocated " << allocs << " times" << endl;
+			}
+		}
+		frames++;
+		updateTrace();
 		// Poll for and process events.
 		glfwPollEvents();
 	}
 	// Quit program.
+	simThread->stop();
+	keyToggles[(unsigned)'t'] = false;
+	updateTrace();
+	if (Profiler::isEnabled()) {
+		Profiler::report(cout);
+	}
+	if (opts.allocWarmup >= 0) {
+		cout << allocFrames << " frames after frame " << opts.allocWarmup << " allocated memory" << endl;
+	}
 	glfwDestroyWindow(window);
 	glfwTerminate();
-	return 0;
+	return allocFrames > 0 ? -1 : 0;
 }
@@ -0,0 +1,235 @@
+// Writes a synthetic data directory for scaling tests: input.txt, an OBJ
+// tube, its skinning weights and an animated bone chain that bends it.
+// Usage: gen_assets <OUT DIR> [--verts N] [--bones N] [--influences N]
+//                   [--frames N] [--binary]
+// The tube has rings of vertices along y, one bone per equal slice of its
+// height; each vertex is weighted to its nearest bones. With --binary the
+// skeleton is also written in the format of tools/skel2bin, and input.txt
+// loads that one. OUT DIR is created if it does not exist; its parent must.
+
+#include <algorithm>
+#define _USE_MATH_DEFINES
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "../Skeleton.h"
+
+using namespace std;
+
+const float HEIGHT = 170.0f;
+const float RADIUS = 20.0f;
+
+// Creates dir unless it already exists
+static bool makeDir(const string &dir)
+{
+#ifdef _WIN32
+	int rc = _mkdir(dir.c_str());
+#else
+	int rc = mkdir(dir.c_str(), 0777);
+#endif
+	if(rc != 0 && errno != EEXIST) {
+		cout << "Cannot create " << dir << endl;
+		return false;
+	}
+	return true;
+}
+
+// Files of millions of lines are written with stdio, which is much faster
+// than iostreams here
+static FILE *openFile(const string &filename)
+{
+	FILE *f = fopen(filename.c_str(), "w");
+	if(!f) {
+		cout << "Cannot write " << filename << endl;
+	}
+	return f;
+}
+
+// A binary skeleton is listed instead of the text one when there is one
+static bool writeInput(const string &dir, bool binary)
+{
+	FILE *f = openFile(dir + "input.txt");
+	if(!f) {
+		return false;
+	}
+	fprintf(f, "# Generated by gen_assets\n");
+	fprintf(f, "MESH mesh.obj skin.txt tex.jpg\n");
+	fprintf(f, "SKELETON %s\n", binary ? "skel.skb" : "skel.txt");
+	fclose(f);
+	return true;
+}
+
+static bool writeMesh(const string &dir, int rings, int segs)
+{
+	FILE *f = openFile(dir + "mesh.obj");
+	if(!f) {
+		return false;
+	}
+	fprintf(f, "# Generated by gen_assets: %d rings of %d vertices\n", rings, segs);
+	for(int r = 0; r < rings; ++r) {
+		float y = HEIGHT * r / max(1, rings - 1);
+		for(int s = 0; s < segs; ++s) {
+			float a = 2.0f * (float)M_PI * s / segs;
+			fprintf(f, "v %f %f %f\n", RADIUS * cos(a), y, RADIUS * sin(a));
+		}
+	}
+	for(int r = 0; r < rings; ++r) {
+		for(int s = 0; s < segs; ++s) {
+			float a = 2.0f * (float)M_PI * s / segs;
+			fprintf(f, "vn %f 0 %f\n", cos(a), sin(a));
+		}
+	}
+	for(int r = 0; r < rings; ++r) {
+		for(int s = 0; s < segs; ++s) {
+			fprintf(f, "vt %f %f\n", (float)s / segs, (float)r / max(1, rings - 1));
+		}
+	}
+	// Two triangles per quad; v/n/t share indices as Shape::loadMesh requires
+	for(int r = 0; r + 1 < rings; ++r) {
+		for(int s = 0; s < segs; ++s) {
+			int a = r * segs + s + 1;
+			int b = r * segs + (s + 1) % segs + 1;
+			int c = a + segs;
+			int d = b + segs;
+			fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b);
+			fprintf(f, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", b, b, b, c, c, c, d, d, d);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+static bool writeWeights(const string &dir, int rings, int segs, int bones, int influences)
+{
+	FILE *f = openFile(dir + "skin.txt");
+	if(!f) {
+		return false;
+	}
+	fprintf(f, "# Generated by gen_assets\n");
+	fprintf(f, "%d %d %d\n", rings * segs, bones, influences);
+	vector<pair<float, int> > nearest(bones);
+	string line;
+	for(int r = 0; r < rings; ++r) {
+		// Every vertex of a ring has the same weights
+		float y = HEIGHT * r / max(1, rings - 1);
+		for(int j = 0; j < bones; ++j) {
+			float center = HEIGHT * (j + 0.5f) / bones;
+			nearest[j] = make_pair(fabs(y - center), j);
+		}
+		partial_sort(nearest.begin(), nearest.begin() + influences, nearest.end());
+		float w[256], sum = 0.0f;
+		for(int i = 0; i < influences; ++i) {
+			w[i] = 1.0f / (1.0f + nearest[i].first * bones / HEIGHT);
+			sum += w[i];
+		}
+		char buf[64];
+		line = to_string(influences);
+		for(int i = 0; i < influences; ++i) {
+			snprintf(buf, sizeof(buf), " %d %f", nearest[i].second, w[i] / sum);
+			line += buf;
+		}
+		line += "\n";
+		for(int s = 0; s < segs; ++s) {
+			fputs(line.c_str(), f);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+// One bone pose: quaternion x y z w, then position
+static void writePose(FILE *f, float angle, float x, float y)
+{
+	fprintf(f, "0 0 %f %f %f %f 0 ", sin(0.5f * angle), cos(0.5f * angle), x, y);
+}
+
+static bool writeSkeleton(const string &dir, int bones, int frames)
+{
+	FILE *f = openFile(dir + "skel.txt");
+	if(!f) {
+		return false;
+	}
+	fprintf(f, "# Generated by gen_assets: frames bones, the bind pose, then one line per frame\n");
+	fprintf(f, "%d %d\n", frames, bones);
+	float length = HEIGHT / bones;
+	// Bind pose: a straight chain up the y axis
+	for(int j = 0; j < bones; ++j) {
+		writePose(f, 0.0f, 0.0f, j * length);
+	}
+	fprintf(f, "\n");
+	// Each bone bends about z relative to its parent, as a travelling wave
+	for(int k = 0; k < frames; ++k) {
+		float angle = 0.0f, x = 0.0f, y = 0.0f;
+		for(int j = 0; j < bones; ++j) {
+			if(j > 0) {
+				x -= length * sin(angle);
+				y += length * cos(angle);
+			}
+			angle += 0.3f / bones * sin(2.0f * (float)M_PI * k / frames + 0.5f * j);
+			writePose(f, angle, x, y);
+		}
+		fprintf(f, "\n");
+	}
+	fclose(f);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 2) {
+		cout << "Usage: gen_assets <OUT DIR> [--verts N] [--bones N] [--influences N]" << endl;
+		cout << "                  [--frames N] [--binary]" << endl;
+		return 1;
+	}
+	string dir = argv[1] + string("/");
+	int verts = 10000, bones = 16, influences = 4, frames = 60;
+	bool binary = false;
+	for(int i = 2; i < argc; ++i) {
+		string arg = argv[i];
+		if(arg == "--verts" && i + 1 < argc) {
+			verts = atoi(argv[++i]);
+		} else if(arg == "--bones" && i + 1 < argc) {
+			bones = atoi(argv[++i]);
+		} else if(arg == "--influences" && i + 1 < argc) {
+			influences = atoi(argv[++i]);
+		} else if(arg == "--frames" && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+		} else if(arg == "--binary") {
+			binary = true;
+		} else {
+			cout << "Unknown option: " << arg << endl;
+		}
+	}
+	// Bone indices are stored as 16 bits
+	bones = min(max(bones, 1), 0xffff);
+	influences = min(max(influences, 1), min(bones, 256));
+	frames = max(frames, 1);
+	// Roughly square quads: the ring count is about 4 times the segment count
+	int segs = max(3, (int)sqrt(max(verts, 3) / 4.0));
+	int rings = max(2, (verts + segs - 1) / segs);
+	
+	if(!makeDir(argv[1]) || !writeInput(dir, binary) || !writeMesh(dir, rings, segs) ||
+	   !writeWeights(dir, rings, segs, bones, influences) || !writeSkeleton(dir, bones, frames)) {
+		return 1;
+	}
+	if(binary) {
+		Skeleton skeleton;
+		if(!skeleton.loadText(dir + "skel.txt") || !skeleton.saveBinary(dir + "skel.skb")) {
+			return 1;
+		}
+	}
+	cout << "Wrote " << rings * segs << " vertices (" << rings << " rings of " << segs << "), "
+		<< bones << " bones, " << influences << " influences, " << frames << " frames to " << dir << endl;
+	return 0;
+}
@@ -0,0 +1,25 @@
+// Converts a text skeleton file to the binary format read by Skeleton.
+// Usage: skel2bin <input.txt> <output.skb>
+
+#include <iostream>
+
+#include "../Skeleton.h"
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+	if(argc < 3) {
+		cout << "Usage: skel2bin <TEXT SKELETON> <BINARY SKELETON>" << endl;
+		return 1;
+	}
+	Skeleton skeleton;
+	if(!skeleton.loadText(argv[1])) {
+		return 1;
+	}
+	if(!skeleton.saveBinary(argv[2])) {
+		return 1;
+	}
+	cout << "Wrote " << skeleton.getBoneCount() << " bones, " << skeleton.getFrameCount() << " frames to " << argv[2] << endl;
+	return 0;
+}